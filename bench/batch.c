@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#define SPSC_FIFO_NDEBUG
+
+#ifdef CACHE_LINE_SIZE
+#define SPSC_FIFO_CACHE_LINE_SIZE CACHE_LINE_SIZE
+#endif
+
+#define SPSC_FIFO_STATIC
+#define SPSC_FIFO_IMPLEMENTATION
+#include "../spsc-fifo.h"
+
+#define ignore (void)
+
+#define NS_IN_S 1000000000L
+
+#define FIFO_CAPACITY (64 * 1024)
+#define TOTAL_BYTES   (256L * 1024 * 1024)
+#define BACKOFF_SPINS 1024
+
+static const spsc_fifo_usize message_sizes[] = {8, 16, 32, 64, 128};
+static const spsc_fifo_usize batch_sizes[]   = {0, 256, 1024, 4096};
+
+struct run {
+    spsc_fifo *fifo;
+    spsc_fifo_usize message_size;
+    spsc_fifo_usize batch;
+    long messages;
+};
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_IN_S + ts.tv_nsec;
+}
+
+static void backoff(unsigned *spins) {
+    if (++(*spins) >= BACKOFF_SPINS) {
+        *spins = 0;
+        thrd_yield();
+    }
+}
+
+static int produce(void *arg) {
+    struct run *run = arg;
+    spsc_fifo_byte message[128];
+    memset(message, 0xab, sizeof(message));
+
+    spsc_fifo_set_write_batch(run->fifo, run->batch);
+    for (long i = 0; i < run->messages; ++i) {
+        unsigned spins = 0;
+        while (!spsc_fifo_write_n(run->fifo, message, run->message_size)) {
+            backoff(&spins);
+        }
+    }
+    spsc_fifo_flush_write(run->fifo);
+
+    return EXIT_SUCCESS;
+}
+
+static int consume(void *arg) {
+    struct run *run = arg;
+    spsc_fifo_byte message[128];
+
+    spsc_fifo_set_read_batch(run->fifo, run->batch);
+    for (long i = 0; i < run->messages; ++i) {
+        unsigned spins = 0;
+        while (!spsc_fifo_read_n(run->fifo, message, run->message_size)) {
+            backoff(&spins);
+        }
+    }
+    spsc_fifo_flush_read(run->fifo);
+
+    return EXIT_SUCCESS;
+}
+
+int main(void) {
+    printf("message_size,batch,msgs_per_s,mb_per_s\n");
+
+    for (size_t m = 0; m < sizeof(message_sizes) / sizeof(*message_sizes); ++m) {
+        for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(*batch_sizes); ++b) {
+            struct run run = {
+                .message_size = message_sizes[m],
+                .batch        = batch_sizes[b],
+                .messages     = TOTAL_BYTES / message_sizes[m],
+            };
+
+            if (spsc_fifo_alloc(&run.fifo, FIFO_CAPACITY) != spsc_fifo_alloc_success) {
+                fprintf(stderr, "failed to allocate fifo\n");
+                return EXIT_FAILURE;
+            }
+
+            thrd_t producer;
+            thrd_t consumer;
+
+            const long start = now_ns();
+            if (thrd_create(&consumer, consume, &run) != thrd_success ||
+                thrd_create(&producer, produce, &run) != thrd_success) {
+                fprintf(stderr, "failed to create threads\n");
+                return EXIT_FAILURE;
+            }
+            thrd_join(producer, NULL);
+            thrd_join(consumer, NULL);
+            const double seconds = (double)(now_ns() - start) / NS_IN_S;
+
+            printf("%u,%u,%.0f,%.1f\n",
+                   run.message_size, run.batch,
+                   (double)run.messages / seconds,
+                   (double)run.messages * run.message_size / seconds / (1024.0 * 1024.0));
+
+            spsc_fifo_free(&run.fifo);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SPSC_FIFO_NDEBUG
+#define SPSC_FIFO_COPY_KERNELS
+
+#ifdef CACHE_LINE_SIZE
+#define SPSC_FIFO_CACHE_LINE_SIZE CACHE_LINE_SIZE
+#endif
+
+#define SPSC_FIFO_STATIC
+#define SPSC_FIFO_IMPLEMENTATION
+#include "../spsc-fifo.h"
+
+#define countof(a) (sizeof(a) / sizeof(*(a)))
+
+#define NS_IN_S 1000000000L
+
+#define ARENA_SIZE  (64L * 1024 * 1024)
+#define TOTAL_BYTES (512L * 1024 * 1024)
+
+static const size_t sizes[] = {8, 16, 32, 48, 64, 256, 4096, 64 * 1024, 256 * 1024, 1024 * 1024};
+
+typedef void (*copy_fn)(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len);
+
+static void copy_memcpy(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    memcpy(to, from, len);
+}
+
+/* What spsc_fifo_copy_to_buf does for a write at or above SPSC_FIFO_STREAM_THRESHOLD. */
+static void copy_stream(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    spsc_fifo_copy(to, from, len, true);
+    spsc_fifo_stream_fence();
+}
+
+static bool always(void) {
+    return true;
+}
+
+#ifdef SPSC_FIFO_X86_KERNELS
+/* Single kernels, with the fence the FIFO adds after them. */
+static void copy_sse2(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    spsc_fifo_stream_sse2(to, from, len);
+    spsc_fifo_stream_fence();
+}
+
+static void copy_avx2(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    spsc_fifo_stream_avx2(to, from, len);
+    spsc_fifo_stream_fence();
+}
+
+static void copy_avx512(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    spsc_fifo_stream_avx512(to, from, len);
+    spsc_fifo_stream_fence();
+}
+
+static bool has_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+static bool has_avx512(void) {
+    return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+struct kernel {
+    const char *name;
+    copy_fn fn;
+    size_t max_size; /* 0 for no limit */
+    bool (*supported)(void);
+};
+
+static const struct kernel kernels[] = {
+    {"memcpy",        copy_memcpy,          0,                         always},
+    {"small",         spsc_fifo_copy_small, SPSC_FIFO_CACHE_LINE_SIZE, always},
+    {"stream",        copy_stream,          0,                         always},
+#ifdef SPSC_FIFO_X86_KERNELS
+    {"stream_sse2",   copy_sse2,            0,                         always},
+    {"stream_avx2",   copy_avx2,            0,                         has_avx2},
+    {"stream_avx512", copy_avx512,          0,                         has_avx512},
+#endif
+};
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_IN_S + ts.tv_nsec;
+}
+
+/* Copies size bytes at a time into a destination arena larger than the last level cache, the way a producer
+   fills a large ring. */
+static double run(copy_fn fn, spsc_fifo_byte *arena, const spsc_fifo_byte *source, size_t size) {
+    const long iterations = TOTAL_BYTES / (long)size;
+    size_t offset = 0;
+
+    const long start = now_ns();
+    for (long i = 0; i < iterations; ++i) {
+        fn(arena + offset, source, size);
+        offset += size;
+        if (offset + size > ARENA_SIZE) {
+            offset = 0;
+        }
+    }
+    const double seconds = (double)(now_ns() - start) / NS_IN_S;
+
+    return (double)iterations * (double)size / seconds / 1e9;
+}
+
+int main(void) {
+    spsc_fifo_byte *arena  = malloc(ARENA_SIZE);
+    spsc_fifo_byte *source = malloc(sizes[countof(sizes) - 1]);
+    if (arena == NULL || source == NULL) {
+        fprintf(stderr, "failed to allocate buffers\n");
+        return EXIT_FAILURE;
+    }
+
+    memset(arena, 0, ARENA_SIZE);
+    memset(source, 0xab, sizes[countof(sizes) - 1]);
+
+    printf("kernel,size,gb_per_s\n");
+    for (size_t s = 0; s < countof(sizes); ++s) {
+        for (size_t k = 0; k < countof(kernels); ++k) {
+            if (!kernels[k].supported() || (kernels[k].max_size != 0 && sizes[s] >= kernels[k].max_size)) {
+                continue;
+            }
+
+            printf("%s,%zu,%.3f\n", kernels[k].name, sizes[s], run(kernels[k].fn, arena, source, sizes[s]));
+            fflush(stdout);
+        }
+    }
+
+    free(source);
+    free(arena);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+#ifdef CACHE_LINE_SIZE
+#define SPSC_FIFO_CACHE_LINE_SIZE CACHE_LINE_SIZE
+#endif
+
+#include "../spsc-fifo.hpp"
+
+/* Same message stream through the C API, spsc::fifo and spsc::typed_fifo. The wrapper rows should match the C
+   row, any difference is abstraction cost. */
+
+constexpr std::uint64_t messages = 50'000'000;
+constexpr spsc::usize capacity = 4096; /* elements */
+constexpr unsigned backoff_spins = 1024;
+
+static void backoff(unsigned& spins) {
+    if (++spins >= backoff_spins) {
+        spins = 0;
+        std::this_thread::yield();
+    }
+}
+
+template <class Produce, class Consume>
+static double run(Produce produce, Consume consume) {
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread consumer([&] {
+        for (std::uint64_t i = 0; i < messages; ++i) {
+            unsigned spins = 0;
+            std::uint64_t value;
+            while (!consume(value)) {
+                backoff(spins);
+            }
+            if (value != i) {
+                std::fprintf(stderr, "out of order: %llu != %llu\n", (unsigned long long)value, (unsigned long long)i);
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    });
+
+    for (std::uint64_t i = 0; i < messages; ++i) {
+        unsigned spins = 0;
+        while (!produce(i)) {
+            backoff(spins);
+        }
+    }
+    consumer.join();
+
+    const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(messages) / seconds.count();
+}
+
+int main() {
+    std::printf("api,msgs_per_s\n");
+
+    {
+        spsc_fifo *fifo;
+        if (spsc_fifo_alloc(&fifo, capacity * sizeof(std::uint64_t)) != spsc_fifo_alloc_success) {
+            std::fprintf(stderr, "failed to allocate fifo\n");
+            return EXIT_FAILURE;
+        }
+        const double rate = run(
+            [&](std::uint64_t value) { return spsc_fifo_write_obj(fifo, &value); },
+            [&](std::uint64_t& value) { return spsc_fifo_read_obj(fifo, &value); });
+        std::printf("c,%.0f\n", rate);
+        spsc_fifo_free(&fifo);
+    }
+
+    {
+        spsc::fifo fifo(capacity * sizeof(std::uint64_t));
+        const double rate = run(
+            [&](std::uint64_t value) { return fifo.push(value); },
+            [&](std::uint64_t& value) { return fifo.pop(value); });
+        std::printf("fifo,%.0f\n", rate);
+    }
+
+    {
+        auto fifo = std::make_unique<spsc::typed_fifo<std::uint64_t, capacity>>();
+        const double rate = run(
+            [&](std::uint64_t value) { return fifo->try_emplace(value); },
+            [&](std::uint64_t& value) { return fifo->try_pop(value); });
+        std::printf("typed_fifo,%.0f\n", rate);
+    }
+
+    return EXIT_SUCCESS;
+}
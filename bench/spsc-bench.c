@@ -0,0 +1,454 @@
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SPSC_FIFO_NDEBUG
+
+#if defined(BENCH_CACHE_LINE_SIZE)
+#define SPSC_FIFO_CACHE_LINE_SIZE BENCH_CACHE_LINE_SIZE
+#elif defined(CACHE_LINE_SIZE)
+#define SPSC_FIFO_CACHE_LINE_SIZE CACHE_LINE_SIZE
+#endif
+
+#define SPSC_FIFO_STATIC
+#define SPSC_FIFO_IMPLEMENTATION
+#include "../spsc-fifo.h"
+
+#define countof(a) (sizeof(a) / sizeof(*(a)))
+
+#define NS_IN_S 1000000000L
+
+#define BACKOFF_SPINS     1024
+#define MAX_MESSAGE_SIZE  (64 * 1024)
+#define PING_PONG_WARMUP  1000
+#define PING_PONG_CAPACITY (64 * 1024)
+
+static const spsc_fifo_usize message_sizes[] = {8, 64, 512, 4096, 64 * 1024};
+static const spsc_fifo_usize capacities[]    = {16 * 1024, 256 * 1024, 4 * 1024 * 1024};
+static const spsc_fifo_usize alignments[]    = {16, 64, 4096};
+static const spsc_fifo_usize latency_sizes[] = {8, 64, 512, 4096};
+
+enum op {
+    op_write_n_read_n,
+    op_write_read,
+    op_write_n_peek
+};
+
+static const char *const op_names[] = {
+    [op_write_n_read_n] = "write_n/read_n",
+    [op_write_read]     = "write/read",
+    [op_write_n_peek]   = "write_n/peek",
+};
+
+struct options {
+    int producer_cpu;
+    int consumer_cpu;
+    bool json;
+    long total_bytes;
+    long round_trips;
+};
+
+struct run {
+    const struct options *options;
+    spsc_fifo *fifo;
+    spsc_fifo *back; /* ping-pong only */
+    enum op op;
+    spsc_fifo_usize message_size;
+    long messages;
+    long *latencies; /* ping-pong only */
+};
+
+struct result {
+    const char *test;
+    const char *op;
+    spsc_fifo_usize message_size;
+    spsc_fifo_usize capacity;
+    spsc_fifo_usize alignment;
+    double msgs_per_s;
+    double gb_per_s;
+    bool has_latency;
+    long p50_ns;
+    long p99_ns;
+    long p999_ns;
+    long max_ns;
+};
+
+static long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_IN_S + ts.tv_nsec;
+}
+
+static void backoff(unsigned *spins) {
+    if (++(*spins) >= BACKOFF_SPINS) {
+        *spins = 0;
+        thrd_yield();
+    }
+}
+
+/* Pins the calling thread, negative cpu leaves it to the scheduler. */
+static void pin(int cpu) {
+    if (cpu < 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "failed to pin thread to cpu %d\n", cpu);
+    }
+}
+
+static void send_message(spsc_fifo *fifo, enum op op, const spsc_fifo_byte *message, spsc_fifo_usize len) {
+    unsigned spins = 0;
+    if (op == op_write_read) {
+        spsc_fifo_usize sent = 0;
+        while (sent < len) {
+            const spsc_fifo_usize n = spsc_fifo_write(fifo, message + sent, len - sent);
+            if (n == 0) {
+                backoff(&spins);
+            }
+            sent += n;
+        }
+    } else {
+        while (!spsc_fifo_write_n(fifo, message, len)) {
+            backoff(&spins);
+        }
+    }
+}
+
+static void receive_message(spsc_fifo *fifo, enum op op, spsc_fifo_byte *message, spsc_fifo_usize len) {
+    unsigned spins = 0;
+    switch (op) {
+        case op_write_n_read_n:
+            while (!spsc_fifo_read_n(fifo, message, len)) {
+                backoff(&spins);
+            }
+            break;
+        case op_write_read:
+        case op_write_n_peek: {
+            spsc_fifo_usize received = 0;
+            while (received < len) {
+                spsc_fifo_usize n;
+                if (op == op_write_read) {
+                    n = spsc_fifo_read(fifo, message + received, len - received);
+                } else {
+                    n = spsc_fifo_peek(fifo, message + received, len - received);
+                    spsc_fifo_skip(fifo, n);
+                }
+                if (n == 0) {
+                    backoff(&spins);
+                }
+                received += n;
+            }
+            break;
+        }
+    }
+}
+
+static int produce(void *arg) {
+    struct run *run = arg;
+    pin(run->options->producer_cpu);
+
+    static spsc_fifo_byte message[MAX_MESSAGE_SIZE];
+    memset(message, 0xab, run->message_size);
+
+    for (long i = 0; i < run->messages; ++i) {
+        send_message(run->fifo, run->op, message, run->message_size);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int consume(void *arg) {
+    struct run *run = arg;
+    pin(run->options->consumer_cpu);
+
+    static spsc_fifo_byte message[MAX_MESSAGE_SIZE];
+    for (long i = 0; i < run->messages; ++i) {
+        receive_message(run->fifo, run->op, message, run->message_size);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* Ping side: stamps each round trip, the first PING_PONG_WARMUP are discarded. */
+static int ping(void *arg) {
+    struct run *run = arg;
+    pin(run->options->producer_cpu);
+
+    static spsc_fifo_byte message[MAX_MESSAGE_SIZE];
+    memset(message, 0xab, run->message_size);
+
+    for (long i = -PING_PONG_WARMUP; i < run->messages; ++i) {
+        const long start = now_ns();
+        send_message(run->fifo, op_write_n_read_n, message, run->message_size);
+        receive_message(run->back, op_write_n_read_n, message, run->message_size);
+        if (i >= 0) {
+            run->latencies[i] = now_ns() - start;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int pong(void *arg) {
+    struct run *run = arg;
+    pin(run->options->consumer_cpu);
+
+    static spsc_fifo_byte message[MAX_MESSAGE_SIZE];
+    for (long i = -PING_PONG_WARMUP; i < run->messages; ++i) {
+        receive_message(run->fifo, op_write_n_read_n, message, run->message_size);
+        send_message(run->back, op_write_n_read_n, message, run->message_size);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static bool run_threads(struct run *run, thrd_start_t first, thrd_start_t second) {
+    thrd_t a;
+    thrd_t b;
+    if (thrd_create(&a, first, run) != thrd_success) {
+        return false;
+    }
+    if (thrd_create(&b, second, run) != thrd_success) {
+        thrd_join(a, NULL);
+        return false;
+    }
+    thrd_join(a, NULL);
+    thrd_join(b, NULL);
+    return true;
+}
+
+static int compare_long(const void *a, const void *b) {
+    const long x = *(const long*)a;
+    const long y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+static long percentile(const long *sorted, long count, double p) {
+    long i = (long)(p * (double)count);
+    return sorted[i < count ? i : count - 1];
+}
+
+static void print_header(const struct options *options) {
+    if (options->json) {
+        printf("[\n");
+    } else {
+        printf("test,op,message_size,capacity,alignment,cache_line_size,counter_bits,msgs_per_s,gb_per_s,p50_ns,p99_ns,p999_ns,max_ns\n");
+    }
+}
+
+static void print_result(const struct options *options, const struct result *r, bool first) {
+    /* latency columns only apply to ping-pong rows, left empty (null) otherwise */
+    char latency[4][24];
+    const long values[4] = {r->p50_ns, r->p99_ns, r->p999_ns, r->max_ns};
+    for (size_t i = 0; i < countof(values); ++i) {
+        if (r->has_latency) {
+            snprintf(latency[i], sizeof(latency[i]), "%ld", values[i]);
+        } else {
+            snprintf(latency[i], sizeof(latency[i]), "%s", options->json ? "null" : "");
+        }
+    }
+
+    if (options->json) {
+        printf("%s  {\"test\": \"%s\", \"op\": \"%s\", \"message_size\": %llu, \"capacity\": %llu, \"alignment\": %llu, "
+               "\"cache_line_size\": %d, \"counter_bits\": %d, \"msgs_per_s\": %.0f, \"gb_per_s\": %.3f, "
+               "\"p50_ns\": %s, \"p99_ns\": %s, \"p999_ns\": %s, \"max_ns\": %s}",
+               first ? "" : ",\n",
+               r->test, r->op,
+               (unsigned long long)r->message_size, (unsigned long long)r->capacity, (unsigned long long)r->alignment,
+               SPSC_FIFO_CACHE_LINE_SIZE, (int)(sizeof(spsc_fifo_usize) * 8),
+               r->msgs_per_s, r->gb_per_s, latency[0], latency[1], latency[2], latency[3]);
+    } else {
+        printf("%s,%s,%llu,%llu,%llu,%d,%d,%.0f,%.3f,%s,%s,%s,%s\n",
+               r->test, r->op,
+               (unsigned long long)r->message_size, (unsigned long long)r->capacity, (unsigned long long)r->alignment,
+               SPSC_FIFO_CACHE_LINE_SIZE, (int)(sizeof(spsc_fifo_usize) * 8),
+               r->msgs_per_s, r->gb_per_s, latency[0], latency[1], latency[2], latency[3]);
+    }
+    fflush(stdout);
+}
+
+static void print_footer(const struct options *options) {
+    if (options->json) {
+        printf("\n]\n");
+    }
+}
+
+static bool bench_throughput(const struct options *options, bool *first) {
+    for (size_t o = 0; o < countof(op_names); ++o) {
+        for (size_t c = 0; c < countof(capacities); ++c) {
+            for (size_t a = 0; a < countof(alignments); ++a) {
+                for (size_t m = 0; m < countof(message_sizes); ++m) {
+                    /* whole-message writes need the message to fit */
+                    if (o != op_write_read && message_sizes[m] > capacities[c]) {
+                        continue;
+                    }
+
+                    struct run run = {
+                        .options      = options,
+                        .op           = (enum op)o,
+                        .message_size = message_sizes[m],
+                        .messages     = options->total_bytes / message_sizes[m],
+                    };
+                    if (run.messages == 0) {
+                        run.messages = 1;
+                    }
+
+                    if (spsc_fifo_aligned_alloc(&run.fifo, capacities[c], alignments[a]) != spsc_fifo_alloc_success) {
+                        fprintf(stderr, "failed to allocate fifo\n");
+                        return false;
+                    }
+
+                    const long start = now_ns();
+                    const bool ok = run_threads(&run, consume, produce);
+                    const double seconds = (double)(now_ns() - start) / NS_IN_S;
+                    spsc_fifo_free(&run.fifo);
+                    if (!ok) {
+                        fprintf(stderr, "failed to create threads\n");
+                        return false;
+                    }
+
+                    const struct result result = {
+                        .test         = "throughput",
+                        .op           = op_names[o],
+                        .message_size = message_sizes[m],
+                        .capacity     = capacities[c],
+                        .alignment    = alignments[a],
+                        .msgs_per_s   = (double)run.messages / seconds,
+                        .gb_per_s     = (double)run.messages * message_sizes[m] / seconds / 1e9,
+                    };
+                    print_result(options, &result, *first);
+                    *first = false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool bench_latency(const struct options *options, bool *first) {
+    long *latencies = malloc((size_t)options->round_trips * sizeof(*latencies));
+    if (latencies == NULL) {
+        fprintf(stderr, "failed to allocate latency samples\n");
+        return false;
+    }
+
+    for (size_t m = 0; m < countof(latency_sizes); ++m) {
+        struct run run = {
+            .options      = options,
+            .message_size = latency_sizes[m],
+            .messages     = options->round_trips,
+            .latencies    = latencies,
+        };
+
+        if (spsc_fifo_alloc(&run.fifo, PING_PONG_CAPACITY) != spsc_fifo_alloc_success ||
+            spsc_fifo_alloc(&run.back, PING_PONG_CAPACITY) != spsc_fifo_alloc_success) {
+            fprintf(stderr, "failed to allocate fifo\n");
+            free(latencies);
+            return false;
+        }
+
+        const bool ok = run_threads(&run, pong, ping);
+        spsc_fifo_free(&run.fifo);
+        spsc_fifo_free(&run.back);
+        if (!ok) {
+            fprintf(stderr, "failed to create threads\n");
+            free(latencies);
+            return false;
+        }
+
+        qsort(latencies, (size_t)run.messages, sizeof(*latencies), compare_long);
+
+        long total = 0;
+        for (long i = 0; i < run.messages; ++i) {
+            total += latencies[i];
+        }
+
+        const double seconds = (double)total / NS_IN_S;
+        const struct result result = {
+            .test         = "ping_pong",
+            .op           = op_names[op_write_n_read_n],
+            .message_size = latency_sizes[m],
+            .capacity     = PING_PONG_CAPACITY,
+            .alignment    = SPSC_FIFO_CACHE_LINE_SIZE,
+            .msgs_per_s   = (double)run.messages / seconds,
+            .gb_per_s     = (double)run.messages * latency_sizes[m] / seconds / 1e9,
+            .has_latency  = true,
+            .p50_ns       = percentile(latencies, run.messages, 0.50),
+            .p99_ns       = percentile(latencies, run.messages, 0.99),
+            .p999_ns      = percentile(latencies, run.messages, 0.999),
+            .max_ns       = latencies[run.messages - 1],
+        };
+        print_result(options, &result, *first);
+        *first = false;
+    }
+
+    free(latencies);
+    return true;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [-p producer_cpu] [-c consumer_cpu] [-n total_bytes] [-r round_trips] [-f csv|json] [-t all|throughput|latency]\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    struct options options = {
+        .producer_cpu = -1,
+        .consumer_cpu = -1,
+        .json         = false,
+        .total_bytes  = 64L * 1024 * 1024,
+        .round_trips  = 100000,
+    };
+    bool throughput = true;
+    bool latency = true;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:c:n:r:f:t:h")) != -1) {
+        switch (opt) {
+            case 'p': options.producer_cpu = atoi(optarg); break;
+            case 'c': options.consumer_cpu = atoi(optarg); break;
+            case 'n': options.total_bytes = atol(optarg); break;
+            case 'r': options.round_trips = atol(optarg); break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) {
+                    options.json = true;
+                } else if (strcmp(optarg, "csv") != 0) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 't':
+                throughput = strcmp(optarg, "latency") != 0;
+                latency = strcmp(optarg, "throughput") != 0;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (options.total_bytes <= 0 || options.round_trips <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bool first = true;
+    print_header(&options);
+    const bool ok = (!throughput || bench_throughput(&options, &first)) &&
+                    (!latency || bench_latency(&options, &first));
+    print_footer(&options);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../spsc-pipeline.h"
+
+#define ignore (void)
+
+#define COUNT 1000000
+
+struct source {
+    unsigned long long next;
+};
+
+struct sink {
+    unsigned long long sum;
+    unsigned long long received;
+};
+
+int generate(spsc_fifo *in, spsc_fifo *out, void *arg) {
+    ignore in;
+    struct source *source = arg;
+
+    if (source->next == COUNT) {
+        return spsc_pipeline_done;
+    }
+
+    if (!spsc_fifo_write_obj(out, &(source->next))) {
+        return spsc_pipeline_idle;
+    }
+
+    ++source->next;
+    return spsc_pipeline_progress;
+}
+
+int square(spsc_fifo *in, spsc_fifo *out, void *arg) {
+    ignore arg;
+    unsigned long long value;
+
+    if (spsc_fifo_write_avail(out) < sizeof(value) || !spsc_fifo_read_obj(in, &value)) {
+        return spsc_pipeline_idle;
+    }
+
+    value *= value;
+    spsc_fifo_write_obj(out, &value);
+    return spsc_pipeline_progress;
+}
+
+int sum(spsc_fifo *in, spsc_fifo *out, void *arg) {
+    ignore out;
+    struct sink *sink = arg;
+    unsigned long long value;
+
+    if (!spsc_fifo_read_obj(in, &value)) {
+        return spsc_pipeline_idle;
+    }
+
+    sink->sum += value;
+    ++sink->received;
+    return spsc_pipeline_progress;
+}
+
+int main(void) {
+    struct source source = {0};
+    struct sink sink = {0};
+
+    const spsc_pipeline_stage stages[] = {
+        {.fn = generate, .arg = &source, .cpu = 0,  .wait = spsc_pipeline_wait_backoff},
+        {.fn = square,   .arg = NULL,    .cpu = 1,  .wait = spsc_pipeline_wait_backoff},
+        {.fn = sum,      .arg = &sink,   .cpu = -1, .wait = spsc_pipeline_wait_backoff},
+    };
+    const unsigned count = sizeof(stages) / sizeof(*stages);
+
+    spsc_pipeline *pipeline;
+    if (spsc_pipeline_alloc(&pipeline, stages, count, 64 * 1024) != spsc_fifo_alloc_success) {
+        fprintf(stderr, "failed to allocate pipeline\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!spsc_pipeline_start(pipeline)) {
+        fprintf(stderr, "failed to start pipeline\n");
+        spsc_pipeline_free(&pipeline);
+        return EXIT_FAILURE;
+    }
+
+    spsc_pipeline_join(pipeline);
+
+    printf("received %llu values, sum of squares %llu\n", sink.received, sink.sum);
+    for (unsigned i = 0; i < count; ++i) {
+        spsc_pipeline_stage_stats stats;
+        spsc_pipeline_stats(pipeline, i, &stats);
+        printf("stage %u: %llu progress, %llu idle, utilization %.1f%%%s\n",
+               i, stats.progress, stats.idle, stats.utilization * 100.0, stats.pinned ? ", pinned" : "");
+    }
+
+    spsc_pipeline_free(&pipeline);
+
+    return EXIT_SUCCESS;
+}
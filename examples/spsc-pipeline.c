@@ -0,0 +1,2 @@
+#define SPSC_PIPELINE_IMPLEMENTATION
+#include "../spsc-pipeline.h"
@@ -1,4 +1,3 @@
-#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,8 +22,6 @@ struct message {
 
 spsc_fifo *fifo;
 
-atomic_bool producer_done = false;
-
 int produce(void *arg) {
     ignore arg;
     spsc_fifo_bind_producer(fifo);
@@ -40,7 +37,7 @@ int produce(void *arg) {
         nanosleep(&(struct timespec) {.tv_sec = 0, .tv_nsec = 500 * NS_IN_MS}, NULL);
     }
 
-    atomic_store(&producer_done, true);
+    spsc_fifo_close_write(fifo);
 
     return EXIT_SUCCESS;
 }
@@ -54,7 +51,7 @@ int consume(void *arg) {
         if (spsc_fifo_read_obj(fifo, &message)) {
             printf("Received message %d: %s\n", message.id, message.buffer);
         } else {
-            if (atomic_load(&producer_done) == true && spsc_fifo_is_empty(fifo)) {
+            if (spsc_fifo_is_eof(fifo)) {
                 break;
             }
 
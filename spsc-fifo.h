@@ -17,6 +17,20 @@
      #define SPSC_FIFO_FREE(p)               - override default memory deallocation implementation (default: free)
      #define SPSC_FIFO_CACHE_LINE_SIZE       - override default cache line size (default: 64 bytes)
      #define SPSC_FIFO_DEFAULT_BUF_ALIGNMENT - override default buffer alignment (default: _Alignof(max_align_t))
+     #define SPSC_FIFO_NO_MMAP               - disable mirrored (memfd + mmap) buffers, spsc_fifo_mmap_alloc falls back to SPSC_FIFO_ALLOC
+     #define SPSC_FIFO_NO_SHM                - disable POSIX shared memory FIFOs, spsc_fifo_shm_* return spsc_fifo_alloc_syserr
+     #define SPSC_FIFO_WAIT                  - enable blocking functions, publishing then also wakes a parked peer (futex on Linux)
+     #define SPSC_FIFO_SPIN_COUNT            - override number of busy-wait iterations before a blocking function parks (default: 1024)
+     #define SPSC_FIFO_COPY_KERNELS          - use tuned copy kernels: small-copy path, streaming stores for large writes
+                                       (runtime AVX-512/AVX2/SSE2 dispatch on x86) and prefetch of published read data
+     #define SPSC_FIFO_STREAM_THRESHOLD      - override smallest write copied with streaming stores (default: 65536 bytes)
+     #define SPSC_FIFO_PREFETCH_BYTES        - override bytes of published data prefetched after each read (default: 256)
+     #define SPSC_FIFO_64BIT                 - use 64-bit sizes and counters, allowing capacities above 2 GiB
+     #define SPSC_FIFO_STATS                 - keep per-side operation counters, readable with spsc_fifo_stats_snapshot
+     #define SPSC_FIFO_SEG_CACHE             - override number of drained segments a segmented FIFO keeps for reuse (default: 4)
+     #define SPSC_FIFO_TRACE                 - histogram how long sampled published data stays in the FIFO, see spsc_fifo_trace_snapshot
+     #define SPSC_FIFO_TRACE_RATE            - override default sampling, one in this many publishes is traced (default: 1024)
+     #define SPSC_FIFO_EVENTFD               - enable eventfds signalling data/space for event loops, see spsc_fifo_read_fd (Linux)
 
    License: MIT (see end of file for license information)
 */
@@ -39,20 +53,65 @@ extern "C" {
 
 /* Types */
 typedef struct spsc_fifo spsc_fifo;
-typedef unsigned int     spsc_fifo_usize;
-typedef unsigned char    spsc_fifo_byte;
+#ifdef SPSC_FIFO_64BIT
+typedef unsigned long long spsc_fifo_usize;
+#else
+typedef unsigned int       spsc_fifo_usize;
+#endif
+typedef unsigned char      spsc_fifo_byte;
+
+typedef struct spsc_fifo_region {
+    spsc_fifo_byte  *ptr;
+    spsc_fifo_usize  len;
+} spsc_fifo_region;
 
 enum spsc_fifo_alloc_status {
     spsc_fifo_alloc_success = 0,
     spsc_fifo_alloc_inval,
-    spsc_fifo_alloc_nomem
+    spsc_fifo_alloc_nomem,
+    spsc_fifo_alloc_syserr,  /* a system call failed, errno holds the reason */
+    spsc_fifo_alloc_mismatch /* an existing shared FIFO has an incompatible or uninitialized header */
+};
+
+enum spsc_fifo_alloc_flag {
+    spsc_fifo_alloc_flag_hugetlb  = 1 << 0, /* explicit huge pages (MAP_HUGETLB), falls back to normal pages */
+    spsc_fifo_alloc_flag_thp      = 1 << 1, /* transparent huge pages (MADV_HUGEPAGE), buffer aligned for them */
+    spsc_fifo_alloc_flag_prefault = 1 << 2, /* touch every page before returning */
+    spsc_fifo_alloc_flag_mlock    = 1 << 3, /* lock pages in memory */
+    spsc_fifo_alloc_flag_numa     = 1 << 4  /* reported only: buffer was bound to numa_node */
 };
 
+typedef struct spsc_fifo_alloc_options {
+    spsc_fifo_usize buf_alignment; /* 0 selects SPSC_FIFO_DEFAULT_BUF_ALIGNMENT */
+    unsigned flags;                /* spsc_fifo_alloc_flag bits */
+    int numa_node;                 /* node to bind the buffer to, negative for no binding */
+} spsc_fifo_alloc_options;
+
 /* General management functions */
 SPSC_FIFO_DEF int  spsc_fifo_alloc        (spsc_fifo **fifo, spsc_fifo_usize min_capacity);
 SPSC_FIFO_DEF int  spsc_fifo_aligned_alloc(spsc_fifo **fifo, spsc_fifo_usize min_capacity, spsc_fifo_usize buf_alignment);
+SPSC_FIFO_DEF int  spsc_fifo_mmap_alloc   (spsc_fifo **fifo, spsc_fifo_usize min_capacity);
+SPSC_FIFO_DEF int  spsc_fifo_alloc_ex     (spsc_fifo **fifo, spsc_fifo_usize min_capacity, const spsc_fifo_alloc_options *options);
 SPSC_FIFO_DEF void spsc_fifo_free         (spsc_fifo **fifo);
 SPSC_FIFO_DEF void spsc_fifo_reset        (spsc_fifo  *fifo);
+SPSC_FIFO_DEF bool spsc_fifo_is_mirrored  (spsc_fifo  *fifo);
+SPSC_FIFO_DEF unsigned spsc_fifo_alloc_flags(spsc_fifo *fifo); /* options spsc_fifo_alloc_ex could honor */
+
+/* Cross-process functions (POSIX shared memory, one producer process and one consumer process),
+   release the local mapping with spsc_fifo_free */
+SPSC_FIFO_DEF int  spsc_fifo_shm_create(spsc_fifo **fifo, const char *name, spsc_fifo_usize min_capacity);
+SPSC_FIFO_DEF int  spsc_fifo_shm_attach(spsc_fifo **fifo, const char *name);
+SPSC_FIFO_DEF bool spsc_fifo_shm_unlink(const char *name);
+
+/* File-backed FIFOs (POSIX): header and buffer live in a shared mapping of the file at path, so everything
+   published survives a crash of the process and reopening resumes from the stored counters. Publishing never
+   writes the mapping back itself: spsc_fifo_file_sync_due reports once sync_interval bytes (0 never) were
+   published since the last checkpoint, and the caller then runs spsc_fifo_file_sync where blocking is acceptable.
+   A power failure can lose or corrupt what was published after the last checkpoint. One process opens the file
+   at a time. */
+SPSC_FIFO_DEF int  spsc_fifo_file_open    (spsc_fifo **fifo, const char *path, spsc_fifo_usize min_capacity, spsc_fifo_usize sync_interval);
+SPSC_FIFO_DEF bool spsc_fifo_file_sync    (spsc_fifo *fifo); /* either side, checkpoint now (msync, blocks) */
+SPSC_FIFO_DEF bool spsc_fifo_file_sync_due(spsc_fifo *fifo); /* producer, false for other kinds */
 
 /* Debugging functions */
 SPSC_FIFO_DEF void spsc_fifo_bind_producer(spsc_fifo *fifo);
@@ -67,12 +126,184 @@ SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_read      (spsc_fifo *fifo, spsc_fifo_by
 SPSC_FIFO_DEF bool            spsc_fifo_read_n    (spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize len);
 SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_peek      (spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max);
 SPSC_FIFO_DEF bool            spsc_fifo_peek_n    (spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize len);
+SPSC_FIFO_DEF void            spsc_fifo_set_read_batch(spsc_fifo *fifo, spsc_fifo_usize bytes);
+SPSC_FIFO_DEF void            spsc_fifo_flush_read    (spsc_fifo *fifo);
+
+/* Zero-copy consumer functions */
+SPSC_FIFO_DEF spsc_fifo_usize       spsc_fifo_read_acquire       (spsc_fifo *fifo, spsc_fifo_region regions[2], spsc_fifo_usize max);
+SPSC_FIFO_DEF const spsc_fifo_byte *spsc_fifo_read_acquire_contig(spsc_fifo *fifo, spsc_fifo_usize len);
+SPSC_FIFO_DEF void                  spsc_fifo_read_release       (spsc_fifo *fifo, spsc_fifo_usize len);
 
 /* Producer functions */
 SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_write_avail(spsc_fifo *fifo);
 SPSC_FIFO_DEF bool            spsc_fifo_is_full    (spsc_fifo *fifo);
 SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_write      (spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len);
 SPSC_FIFO_DEF bool            spsc_fifo_write_n    (spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len);
+SPSC_FIFO_DEF void            spsc_fifo_set_write_batch(spsc_fifo *fifo, spsc_fifo_usize bytes);
+SPSC_FIFO_DEF void            spsc_fifo_flush_write    (spsc_fifo *fifo);
+
+/* Zero-copy producer functions */
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_write_reserve       (spsc_fifo *fifo, spsc_fifo_region regions[2], spsc_fifo_usize max);
+SPSC_FIFO_DEF spsc_fifo_byte *spsc_fifo_write_reserve_contig(spsc_fifo *fifo, spsc_fifo_usize len);
+SPSC_FIFO_DEF void            spsc_fifo_write_commit        (spsc_fifo *fifo, spsc_fifo_usize len);
+
+/* Closing: the producer closes after its last write (end of stream), the consumer when it stops reading
+   (shutdown). Blocking functions stop waiting for data or space once the FIFO is closed. */
+SPSC_FIFO_DEF void spsc_fifo_close_write(spsc_fifo *fifo); /* producer, publishes pending writes first */
+SPSC_FIFO_DEF void spsc_fifo_close_read (spsc_fifo *fifo); /* consumer */
+SPSC_FIFO_DEF bool spsc_fifo_is_closed  (spsc_fifo *fifo); /* either side closed */
+SPSC_FIFO_DEF bool spsc_fifo_is_eof     (spsc_fifo *fifo); /* consumer, closed and nothing left to read */
+
+/* Fan-in group: one consumer polling many FIFOs, each with its own producer. Producers mark their FIFO in a
+   readiness bitmap when they publish, so the consumer only touches FIFOs that may hold data. Members must be
+   added before their producers start and the group freed only after they stopped. Not for shared memory FIFOs. */
+typedef struct spsc_fifo_group spsc_fifo_group;
+
+SPSC_FIFO_DEF int        spsc_fifo_group_alloc     (spsc_fifo_group **group, spsc_fifo_usize max_members);
+SPSC_FIFO_DEF void       spsc_fifo_group_free      (spsc_fifo_group **group);
+SPSC_FIFO_DEF bool       spsc_fifo_group_add       (spsc_fifo_group  *group, spsc_fifo *fifo);
+SPSC_FIFO_DEF spsc_fifo *spsc_fifo_group_next_ready(spsc_fifo_group  *group); /* round-robin, NULL if all are empty */
+
+/* Broadcast FIFO: one producer, a fixed number of consumers that each see every byte through their own cursor,
+   identified by index 0..consumers-1. Space is reclaimed once the slowest consumer has read it. */
+typedef struct spsc_fifo_bcast spsc_fifo_bcast;
+
+SPSC_FIFO_DEF int  spsc_fifo_bcast_alloc(spsc_fifo_bcast **bcast, spsc_fifo_usize min_capacity, unsigned consumers);
+SPSC_FIFO_DEF void spsc_fifo_bcast_free (spsc_fifo_bcast **bcast);
+
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_bcast_write_avail(spsc_fifo_bcast *bcast);
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_bcast_write      (spsc_fifo_bcast *bcast, const spsc_fifo_byte *from, spsc_fifo_usize len);
+SPSC_FIFO_DEF bool            spsc_fifo_bcast_write_n    (spsc_fifo_bcast *bcast, const spsc_fifo_byte *from, spsc_fifo_usize len);
+
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_bcast_read_avail(spsc_fifo_bcast *bcast, unsigned consumer);
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_bcast_skip      (spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_usize amount);
+SPSC_FIFO_DEF bool            spsc_fifo_bcast_skip_n    (spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_usize amount);
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_bcast_read      (spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_byte *to, spsc_fifo_usize max);
+SPSC_FIFO_DEF bool            spsc_fifo_bcast_read_n    (spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_byte *to, spsc_fifo_usize len);
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_bcast_peek      (spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_byte *to, spsc_fifo_usize max);
+SPSC_FIFO_DEF bool            spsc_fifo_bcast_peek_n    (spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_byte *to, spsc_fifo_usize len);
+
+SPSC_FIFO_DEF void spsc_fifo_bcast_bind_producer(spsc_fifo_bcast *bcast);
+SPSC_FIFO_DEF void spsc_fifo_bcast_bind_consumer(spsc_fifo_bcast *bcast, unsigned consumer); /* binds that cursor only */
+
+/* Segmented FIFO: a chain of equally sized rings that grows when the producer fills its segment and shrinks as
+   the consumer drains them, so memory follows the backlog. Drained segments are kept for reuse while the total
+   stays within soft_cap, the producer never holds more than hard_cap; 0 disables either cap. */
+typedef struct spsc_fifo_seg spsc_fifo_seg;
+
+SPSC_FIFO_DEF int  spsc_fifo_seg_alloc(spsc_fifo_seg **seg, spsc_fifo_usize segment_capacity, spsc_fifo_usize soft_cap, spsc_fifo_usize hard_cap);
+SPSC_FIFO_DEF void spsc_fifo_seg_free (spsc_fifo_seg **seg);
+
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_seg_write     (spsc_fifo_seg *seg, const spsc_fifo_byte *from, spsc_fifo_usize len);
+SPSC_FIFO_DEF bool            spsc_fifo_seg_write_n   (spsc_fifo_seg *seg, const spsc_fifo_byte *from, spsc_fifo_usize len);
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_seg_read_avail(spsc_fifo_seg *seg);
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_seg_read      (spsc_fifo_seg *seg, spsc_fifo_byte *to, spsc_fifo_usize max);
+SPSC_FIFO_DEF bool            spsc_fifo_seg_read_n    (spsc_fifo_seg *seg, spsc_fifo_byte *to, spsc_fifo_usize len);
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_seg_memory    (spsc_fifo_seg *seg); /* either side, bytes held in segments */
+
+/* File descriptor functions (POSIX), a single readv/writev over the up to two contiguous regions */
+enum spsc_fifo_io_status {
+    spsc_fifo_io_success = 0, /* *transferred bytes were moved, 0 if the FIFO was full/empty or max was 0 */
+    spsc_fifo_io_again,       /* the nonblocking fd is not ready (EAGAIN/EWOULDBLOCK), nothing was moved */
+    spsc_fifo_io_eof,         /* the fd reached end of file (write_from_fd only) */
+    spsc_fifo_io_error        /* the system call failed, errno holds the reason */
+};
+
+SPSC_FIFO_DEF int spsc_fifo_write_from_fd(spsc_fifo *fifo, int fd, spsc_fifo_usize max, spsc_fifo_usize *transferred); /* producer */
+SPSC_FIFO_DEF int spsc_fifo_read_to_fd   (spsc_fifo *fifo, int fd, spsc_fifo_usize max, spsc_fifo_usize *transferred); /* consumer */
+
+/* Vectored functions (POSIX): segments are copied back to back and published with a single store, elsewhere they
+   always fail */
+struct iovec;
+
+SPSC_FIFO_DEF bool            spsc_fifo_writev_n(spsc_fifo *fifo, const struct iovec *iov, int iovcnt); /* producer, all or nothing */
+SPSC_FIFO_DEF spsc_fifo_usize spsc_fifo_readv   (spsc_fifo *fifo, const struct iovec *iov, int iovcnt); /* consumer, partial allowed */
+SPSC_FIFO_DEF bool            spsc_fifo_readv_n (spsc_fifo *fifo, const struct iovec *iov, int iovcnt); /* consumer, all or nothing */
+
+#ifdef SPSC_FIFO_WAIT
+struct timespec;
+
+/* Blocking functions, deadline is an absolute CLOCK_MONOTONIC time point, NULL waits forever */
+SPSC_FIFO_DEF bool spsc_fifo_wait_readable(spsc_fifo *fifo, spsc_fifo_usize amount, const struct timespec *deadline);
+SPSC_FIFO_DEF bool spsc_fifo_wait_writable(spsc_fifo *fifo, spsc_fifo_usize amount, const struct timespec *deadline);
+SPSC_FIFO_DEF bool spsc_fifo_read_n_wait  (spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize len, const struct timespec *deadline);
+SPSC_FIFO_DEF bool spsc_fifo_write_n_wait (spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len, const struct timespec *deadline);
+
+/* Blocking spsc_fifo_group_next_ready, NULL only once the deadline passed */
+SPSC_FIFO_DEF spsc_fifo *spsc_fifo_group_wait_ready(spsc_fifo_group *group, const struct timespec *deadline);
+#endif
+
+#ifdef SPSC_FIFO_EVENTFD
+/* Event fds (Linux): eventfds for poll/epoll, readable once the FIFO got data (read_fd) or space (write_fd). A side
+   arms its fd for the amount it needs, right before returning to its event loop, and the other side signals it
+   once, on the first publish that makes that amount readable or writable, so steady traffic makes no system
+   calls. Both fds also fire on close. Not for shared memory or file-backed FIFOs. */
+SPSC_FIFO_DEF bool spsc_fifo_enable_fds  (spsc_fifo *fifo); /* before use, false if eventfd failed */
+SPSC_FIFO_DEF int  spsc_fifo_read_fd     (spsc_fifo *fifo); /* -1 if not enabled */
+SPSC_FIFO_DEF int  spsc_fifo_write_fd    (spsc_fifo *fifo); /* -1 if not enabled */
+SPSC_FIFO_DEF bool spsc_fifo_arm_read_fd (spsc_fifo *fifo, spsc_fifo_usize amount); /* consumer, false if amount is readable already or closed: keep reading instead */
+SPSC_FIFO_DEF bool spsc_fifo_arm_write_fd(spsc_fifo *fifo, spsc_fifo_usize amount); /* producer, false if amount is writable already or closed: keep writing instead */
+#endif
+
+#ifdef SPSC_FIFO_STATS
+/* Cumulative counters, each side owns its half. Byte counts include record framing and padding. */
+typedef struct spsc_fifo_stats {
+    unsigned long long bytes_written;
+    unsigned long long writes;         /* successful producer operations */
+    unsigned long long write_full;     /* writes rejected or cut to zero for lack of space */
+    unsigned long long partial_writes; /* spsc_fifo_write calls that stored fewer bytes than asked */
+    unsigned long long write_splits;   /* copies into the buffer split at the wrap */
+    unsigned long long high_water;     /* highest occupancy seen by the producer (upper bound) */
+
+    unsigned long long bytes_read;
+    unsigned long long reads;          /* successful consumer operations (peeks excluded) */
+    unsigned long long read_empty;     /* reads/peeks/skips rejected or cut to zero for lack of data */
+    unsigned long long partial_reads;  /* spsc_fifo_read/peek/skip calls that returned fewer bytes than asked */
+    unsigned long long read_splits;    /* copies out of the buffer split at the wrap */
+} spsc_fifo_stats;
+
+/* Safe to call from any thread, counters are read individually so the snapshot is not atomic as a whole */
+SPSC_FIFO_DEF void spsc_fifo_stats_snapshot(spsc_fifo *fifo, spsc_fifo_stats *stats);
+#endif
+
+#ifdef SPSC_FIFO_TRACE
+#undef SPSC_FIFO_TRACE_SUB_BITS
+#define SPSC_FIFO_TRACE_SUB_BITS 3
+#undef SPSC_FIFO_TRACE_BUCKETS
+#define SPSC_FIFO_TRACE_BUCKETS ((64 - SPSC_FIFO_TRACE_SUB_BITS + 1) << SPSC_FIFO_TRACE_SUB_BITS)
+
+/* Residence time of sampled publishes, from the store that made a range of writes visible until the read that
+   consumed its last byte, in nanoseconds of CLOCK_MONOTONIC. Time spent pending in a write batch is not
+   included. Buckets are log-linear: every power of two is split into 2^SPSC_FIFO_TRACE_SUB_BITS equal parts, so
+   a bucket is at most 12.5% wide. */
+typedef struct spsc_fifo_trace {
+    unsigned long long samples;
+    unsigned long long dropped; /* sampled writes not traced because too many were still in flight */
+    unsigned long long buckets[SPSC_FIFO_TRACE_BUCKETS];
+} spsc_fifo_trace;
+
+SPSC_FIFO_DEF void               spsc_fifo_set_trace_rate   (spsc_fifo *fifo, unsigned every); /* producer, 0 stops sampling */
+SPSC_FIFO_DEF void               spsc_fifo_trace_snapshot   (spsc_fifo *fifo, spsc_fifo_trace *trace); /* any thread, not atomic as a whole */
+SPSC_FIFO_DEF unsigned long long spsc_fifo_trace_bucket_min (unsigned bucket); /* smallest time counted in bucket */
+SPSC_FIFO_DEF unsigned long long spsc_fifo_trace_percentile (const spsc_fifo_trace *trace, double fraction); /* bucket_min of the bucket holding it */
+#endif
+
+/* Framed record functions (length-prefixed messages, published and consumed whole) */
+#undef SPSC_FIFO_RECORD_HEADER_SIZE
+#define SPSC_FIFO_RECORD_HEADER_SIZE sizeof(spsc_fifo_usize)
+
+SPSC_FIFO_DEF bool spsc_fifo_set_record_format(spsc_fifo *fifo, spsc_fifo_usize alignment, bool contiguous);
+SPSC_FIFO_DEF bool spsc_fifo_push_record      (spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len);
+SPSC_FIFO_DEF bool spsc_fifo_peek_record_len  (spsc_fifo *fifo, spsc_fifo_usize *len); /* no side effects, see README */
+SPSC_FIFO_DEF bool spsc_fifo_pop_record       (spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max, spsc_fifo_usize *len);
+SPSC_FIFO_DEF bool spsc_fifo_skip_record      (spsc_fifo *fifo);
+
+/* Lossy record functions (overwrite oldest): the producer never waits, a lapped consumer skips ahead to the oldest
+   intact record. Records carry a position stamp and a sequence number, so overwritten data is detected rather
+   than returned and losses are counted. Do not mix with the other functions on the same FIFO. */
+SPSC_FIFO_DEF bool spsc_fifo_push_lossy(spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len); /* false only if len can never fit */
+SPSC_FIFO_DEF bool spsc_fifo_pop_lossy (spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max, spsc_fifo_usize *len, unsigned long long *lost);
+SPSC_FIFO_DEF void spsc_fifo_lossy_lost(spsc_fifo *fifo, unsigned long long *records, unsigned long long *bytes); /* consumer, totals */
 
 /* Convenience macros for reading/writing typed values (objects) */
 #undef spsc_fifo_skip_obj
@@ -88,35 +319,44 @@ SPSC_FIFO_DEF bool            spsc_fifo_write_n    (spsc_fifo *fifo, const spsc_
 }
 #endif
 
-#endif //SPSC_FIFO_H
-
-#ifdef SPSC_FIFO_IMPLEMENTATION
+/* Statically sized byte FIFOs (C only)
+
+   SPSC_FIFO_DEFINE_STATIC(name, capacity) generates a byte FIFO with a compile-time power-of-two capacity and an
+   inline, cache-line aligned buffer. It needs no allocation: zero-initialized (static) storage is an empty FIFO,
+   other storage must be initialized with name_init. Generated static inline functions:
+
+     void            name_init       (name *fifo)
+     spsc_fifo_usize name_write_avail(name *fifo)                                             - producer
+     spsc_fifo_usize name_write      (name *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) - producer
+     bool            name_write_n    (name *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) - producer
+     spsc_fifo_usize name_read_avail (name *fifo)                                             - consumer
+     spsc_fifo_usize name_read       (name *fifo, spsc_fifo_byte *to, spsc_fifo_usize max)    - consumer
+     bool            name_read_n     (name *fifo, spsc_fifo_byte *to, spsc_fifo_usize len)    - consumer
+     bool            name_peek_n     (name *fifo, spsc_fifo_byte *to, spsc_fifo_usize len)    - consumer
+     bool            name_skip_n     (name *fifo, spsc_fifo_usize len)                        - consumer
+
+   Typed fixed-slot queues (C only, C++ has spsc::typed_fifo in spsc-fifo.hpp)
+
+   SPSC_FIFO_DEFINE_TYPED(name, T) generates a queue of T counted in elements, with naturally aligned slots and
+   no byte arithmetic, and the following static inline functions:
+
+     int  name_alloc   (name **queue, spsc_fifo_usize min_capacity) - returns spsc_fifo_alloc_status
+     void name_free    (name **queue)
+     T   *name_emplace (name  *queue) - producer: free slot to construct into, or NULL when full
+     void name_commit  (name  *queue) - producer: publish the slot returned by name_emplace
+     bool name_push    (name  *queue, const T *value) - producer: copy value in, false when full
+     T   *name_front   (name  *queue) - consumer: oldest element, or NULL when empty
+     void name_pop     (name  *queue) - consumer: release the element returned by name_front
+     bool name_is_empty(name  *queue) - consumer
+     bool name_is_full (name  *queue) - producer
+*/
+#ifndef __cplusplus
 
-#include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-typedef uintptr_t spsc_fifo_uptr;
-
-#undef SPSC_FIFO_UTIL
-#define SPSC_FIFO_UTIL static inline
-
-#undef SPSC_FIFO_IMPL
-#ifdef SPSC_FIFO_STATIC
-    #define SPSC_FIFO_IMPL static inline
-#else
-    #define SPSC_FIFO_IMPL extern inline
-#endif
-
-#undef SPSC_FIFO_IGNORE
-#define SPSC_FIFO_IGNORE(x) (void)(x)
-
-#ifndef SPSC_FIFO_ASSERT
-#define SPSC_FIFO_ASSERT(expr) assert(expr)
-#endif
-
 #ifndef SPSC_FIFO_ALLOC
 #define SPSC_FIFO_ALLOC(sz) malloc(sz)
 #endif
@@ -129,66 +369,626 @@ typedef uintptr_t spsc_fifo_uptr;
 #define SPSC_FIFO_CACHE_LINE_SIZE 64
 #endif
 
-#ifndef SPSC_FIFO_DEFAULT_BUF_ALIGNMENT
-#define SPSC_FIFO_DEFAULT_BUF_ALIGNMENT _Alignof(max_align_t)
-#endif
-
 #undef SPSC_FIFO_ATOMIC
 #undef SPSC_FIFO_ATOMIC_LOAD
 #undef SPSC_FIFO_ATOMIC_STORE
+#undef SPSC_FIFO_ATOMIC_FETCH_ADD
+#undef SPSC_FIFO_ATOMIC_FETCH_OR
+#undef SPSC_FIFO_ATOMIC_FETCH_AND
+#undef SPSC_FIFO_ATOMIC_THREAD_FENCE
 #undef SPSC_FIFO_MEMORY_ORDER_RELAXED
 #undef SPSC_FIFO_MEMORY_ORDER_ACQUIRE
 #undef SPSC_FIFO_MEMORY_ORDER_RELEASE
+#undef SPSC_FIFO_MEMORY_ORDER_SEQ_CST
 #if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
     #include <stdatomic.h>
     #define SPSC_FIFO_ATOMIC(type)                      _Atomic(type)
     #define SPSC_FIFO_ATOMIC_LOAD(obj_ptr, order)       atomic_load_explicit ((obj_ptr), (order))
     #define SPSC_FIFO_ATOMIC_STORE(obj_ptr, val, order) atomic_store_explicit((obj_ptr), (val), (order))
+    #define SPSC_FIFO_ATOMIC_FETCH_ADD(obj_ptr, val, order) atomic_fetch_add_explicit((obj_ptr), (val), (order))
+    #define SPSC_FIFO_ATOMIC_FETCH_OR(obj_ptr, val, order)  atomic_fetch_or_explicit ((obj_ptr), (val), (order))
+    #define SPSC_FIFO_ATOMIC_FETCH_AND(obj_ptr, val, order) atomic_fetch_and_explicit((obj_ptr), (val), (order))
+    #define SPSC_FIFO_ATOMIC_THREAD_FENCE(order)        atomic_thread_fence(order)
     #define SPSC_FIFO_MEMORY_ORDER_RELAXED              memory_order_relaxed
     #define SPSC_FIFO_MEMORY_ORDER_ACQUIRE              memory_order_acquire
     #define SPSC_FIFO_MEMORY_ORDER_RELEASE              memory_order_release
+    #define SPSC_FIFO_MEMORY_ORDER_SEQ_CST              memory_order_seq_cst
 #else
     #ifdef __GNUC__
         #define SPSC_FIFO_ATOMIC(type)                      type
         #define SPSC_FIFO_ATOMIC_LOAD(obj_ptr, order)       __atomic_load_n ((obj_ptr), (order))
         #define SPSC_FIFO_ATOMIC_STORE(obj_ptr, val, order) __atomic_store_n((obj_ptr), (val), (order))
+        #define SPSC_FIFO_ATOMIC_FETCH_ADD(obj_ptr, val, order) __atomic_fetch_add((obj_ptr), (val), (order))
+        #define SPSC_FIFO_ATOMIC_FETCH_OR(obj_ptr, val, order)  __atomic_fetch_or ((obj_ptr), (val), (order))
+        #define SPSC_FIFO_ATOMIC_FETCH_AND(obj_ptr, val, order) __atomic_fetch_and((obj_ptr), (val), (order))
+        #define SPSC_FIFO_ATOMIC_THREAD_FENCE(order)        __atomic_thread_fence(order)
         #define SPSC_FIFO_MEMORY_ORDER_RELAXED              __ATOMIC_RELAXED
         #define SPSC_FIFO_MEMORY_ORDER_ACQUIRE              __ATOMIC_ACQUIRE
         #define SPSC_FIFO_MEMORY_ORDER_RELEASE              __ATOMIC_RELEASE
+        #define SPSC_FIFO_MEMORY_ORDER_SEQ_CST              __ATOMIC_SEQ_CST
         #warning "C11 atomics are not available. GCC Compiler detected. Using compiler specific fallback."
     #else
         #define SPSC_FIFO_ATOMIC(type)                      type
         #define SPSC_FIFO_ATOMIC_LOAD(obj_ptr, order)       (*(obj_ptr))
         #define SPSC_FIFO_ATOMIC_STORE(obj_ptr, val, order) (*(obj_ptr) = (val))
+        #define SPSC_FIFO_ATOMIC_FETCH_ADD(obj_ptr, val, order) ((*(obj_ptr) += (val)) - (val))
+        #define SPSC_FIFO_ATOMIC_FETCH_OR(obj_ptr, val, order)  (*(obj_ptr) |= (val))
+        #define SPSC_FIFO_ATOMIC_FETCH_AND(obj_ptr, val, order) (*(obj_ptr) &= (val))
+        #define SPSC_FIFO_ATOMIC_THREAD_FENCE(order)        ((void)0)
         #define SPSC_FIFO_MEMORY_ORDER_RELAXED              0
         #define SPSC_FIFO_MEMORY_ORDER_ACQUIRE              0
         #define SPSC_FIFO_MEMORY_ORDER_RELEASE              0
+        #define SPSC_FIFO_MEMORY_ORDER_SEQ_CST              0
         #warning "C11 atomics are not available. Using non-thread-safe fallback."
     #endif
 #endif
 
+static inline void spsc_fifo_ring_put(spsc_fifo_byte *buf, spsc_fifo_usize capacity, spsc_fifo_usize idx, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+    const spsc_fifo_usize l = len < capacity - idx ? len : capacity - idx;
+    memcpy(buf + idx, from, l);
+    if (l < len) {
+        memcpy(buf, from + l, len - l);
+    }
+}
+
+static inline void spsc_fifo_ring_get(const spsc_fifo_byte *buf, spsc_fifo_usize capacity, spsc_fifo_usize idx, spsc_fifo_byte *to, spsc_fifo_usize len) {
+    const spsc_fifo_usize l = len < capacity - idx ? len : capacity - idx;
+    memcpy(to, buf + idx, l);
+    if (l < len) {
+        memcpy(to + l, buf, len - l);
+    }
+}
+
+#undef SPSC_FIFO_DEFINE_STATIC
+#define SPSC_FIFO_DEFINE_STATIC(name, capacity)                                                               \
+    _Static_assert((capacity) > 0 && ((capacity) & ((capacity) - 1)) == 0, #name ": capacity must be a power of two"); \
+                                                                                                              \
+    typedef struct name {                                                                                     \
+        _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) write_count;                    \
+        spsc_fifo_usize read_count_cache;                                                                     \
+        _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) read_count;                     \
+        spsc_fifo_usize write_count_cache;                                                                    \
+        _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) spsc_fifo_byte buf[(capacity)];                                   \
+    } name;                                                                                                   \
+                                                                                                              \
+    static inline void name##_init(name *fifo) {                                                              \
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);                      \
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);                      \
+        fifo->read_count_cache  = 0;                                                                          \
+        fifo->write_count_cache = 0;                                                                          \
+    }                                                                                                         \
+                                                                                                              \
+    static inline spsc_fifo_usize name##_writable(name *fifo, spsc_fifo_usize write_count, spsc_fifo_usize want) { \
+        spsc_fifo_usize write_avail = (capacity) - (write_count - fifo->read_count_cache);                    \
+        if (write_avail < want) {                                                                             \
+            fifo->read_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE); \
+            write_avail = (capacity) - (write_count - fifo->read_count_cache);                                \
+        }                                                                                                     \
+        return write_avail;                                                                                   \
+    }                                                                                                         \
+                                                                                                              \
+    static inline spsc_fifo_usize name##_readable(name *fifo, spsc_fifo_usize read_count, spsc_fifo_usize want) { \
+        spsc_fifo_usize read_avail = fifo->write_count_cache - read_count;                                    \
+        if (read_avail < want) {                                                                              \
+            fifo->write_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE); \
+            read_avail = fifo->write_count_cache - read_count;                                                \
+        }                                                                                                     \
+        return read_avail;                                                                                    \
+    }                                                                                                         \
+                                                                                                              \
+    static inline spsc_fifo_usize name##_write_avail(name *fifo) {                                            \
+        const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        return name##_writable(fifo, write_count, (capacity));                                                \
+    }                                                                                                         \
+                                                                                                              \
+    static inline spsc_fifo_usize name##_write(name *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) { \
+        const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        const spsc_fifo_usize write_avail = name##_writable(fifo, write_count, len);                          \
+        if (len > write_avail) {                                                                              \
+            len = write_avail;                                                                                \
+        }                                                                                                     \
+        if (len == 0) {                                                                                       \
+            return 0;                                                                                         \
+        }                                                                                                     \
+        spsc_fifo_ring_put(fifo->buf, (capacity), write_count & ((capacity) - 1), from, len);                 \
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), write_count + len, SPSC_FIFO_MEMORY_ORDER_RELEASE);      \
+        return len;                                                                                           \
+    }                                                                                                         \
+                                                                                                              \
+    static inline bool name##_write_n(name *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) {          \
+        const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        if (len == 0 || len > name##_writable(fifo, write_count, len)) {                                      \
+            return false;                                                                                     \
+        }                                                                                                     \
+        spsc_fifo_ring_put(fifo->buf, (capacity), write_count & ((capacity) - 1), from, len);                 \
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), write_count + len, SPSC_FIFO_MEMORY_ORDER_RELEASE);      \
+        return true;                                                                                          \
+    }                                                                                                         \
+                                                                                                              \
+    static inline spsc_fifo_usize name##_read_avail(name *fifo) {                                             \
+        const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        return name##_readable(fifo, read_count, (capacity));                                                 \
+    }                                                                                                         \
+                                                                                                              \
+    static inline spsc_fifo_usize name##_read(name *fifo, spsc_fifo_byte *to, spsc_fifo_usize max) {          \
+        const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        const spsc_fifo_usize read_avail = name##_readable(fifo, read_count, max);                            \
+        if (max > read_avail) {                                                                               \
+            max = read_avail;                                                                                 \
+        }                                                                                                     \
+        if (max == 0) {                                                                                       \
+            return 0;                                                                                         \
+        }                                                                                                     \
+        spsc_fifo_ring_get(fifo->buf, (capacity), read_count & ((capacity) - 1), to, max);                    \
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count + max, SPSC_FIFO_MEMORY_ORDER_RELEASE);        \
+        return max;                                                                                           \
+    }                                                                                                         \
+                                                                                                              \
+    static inline bool name##_read_n(name *fifo, spsc_fifo_byte *to, spsc_fifo_usize len) {                   \
+        const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        if (len == 0 || len > name##_readable(fifo, read_count, len)) {                                       \
+            return false;                                                                                     \
+        }                                                                                                     \
+        spsc_fifo_ring_get(fifo->buf, (capacity), read_count & ((capacity) - 1), to, len);                    \
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count + len, SPSC_FIFO_MEMORY_ORDER_RELEASE);        \
+        return true;                                                                                          \
+    }                                                                                                         \
+                                                                                                              \
+    static inline bool name##_peek_n(name *fifo, spsc_fifo_byte *to, spsc_fifo_usize len) {                   \
+        const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        if (len == 0 || len > name##_readable(fifo, read_count, len)) {                                       \
+            return false;                                                                                     \
+        }                                                                                                     \
+        spsc_fifo_ring_get(fifo->buf, (capacity), read_count & ((capacity) - 1), to, len);                    \
+        return true;                                                                                          \
+    }                                                                                                         \
+                                                                                                              \
+    static inline bool name##_skip_n(name *fifo, spsc_fifo_usize len) {                                       \
+        const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        if (len == 0 || len > name##_readable(fifo, read_count, len)) {                                       \
+            return false;                                                                                     \
+        }                                                                                                     \
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count + len, SPSC_FIFO_MEMORY_ORDER_RELEASE);        \
+        return true;                                                                                          \
+    }                                                                                                         \
+                                                                                                              \
+    typedef int name##_require_semicolon
+
+#undef SPSC_FIFO_DEFINE_TYPED
+#define SPSC_FIFO_DEFINE_TYPED(name, T)                                                                       \
+    typedef struct name {                                                                                     \
+        T *slots;                                                                                             \
+        void *mem;                                                                                            \
+        spsc_fifo_usize capacity;                                                                             \
+        spsc_fifo_usize mask;                                                                                 \
+        _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) write_count;                    \
+        spsc_fifo_usize read_count_cache;                                                                     \
+        _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) read_count;                     \
+        spsc_fifo_usize write_count_cache;                                                                    \
+    } name;                                                                                                   \
+                                                                                                              \
+    static inline int name##_alloc(name **queue, spsc_fifo_usize min_capacity) {                              \
+        spsc_fifo_usize capacity = 1;                                                                         \
+        while (capacity < min_capacity && capacity <= ((spsc_fifo_usize)-1) / 2) {                            \
+            capacity <<= 1;                                                                                   \
+        }                                                                                                     \
+        const size_t slots_size = (size_t)capacity * sizeof(T);                                               \
+        const size_t header_size = _Alignof(name) - 1 + sizeof(name) + _Alignof(T) - 1;                       \
+        if (capacity < min_capacity || slots_size / sizeof(T) != capacity || slots_size > SIZE_MAX - header_size) { \
+            return spsc_fifo_alloc_inval;                                                                     \
+        }                                                                                                     \
+                                                                                                              \
+        void *mem = SPSC_FIFO_ALLOC(header_size + slots_size);                                                \
+        if (mem == NULL) {                                                                                    \
+            return spsc_fifo_alloc_nomem;                                                                     \
+        }                                                                                                     \
+                                                                                                              \
+        *queue = (name*)(((uintptr_t)mem + _Alignof(name) - 1) & ~((uintptr_t)_Alignof(name) - 1));          \
+        (*queue)->slots = (T*)(((uintptr_t)(*queue + 1) + _Alignof(T) - 1) & ~((uintptr_t)_Alignof(T) - 1)); \
+        (*queue)->mem = mem;                                                                                  \
+        (*queue)->capacity = capacity;                                                                        \
+        (*queue)->mask = capacity - 1;                                                                        \
+        SPSC_FIFO_ATOMIC_STORE(&((*queue)->write_count), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);                  \
+        SPSC_FIFO_ATOMIC_STORE(&((*queue)->read_count),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);                  \
+        (*queue)->read_count_cache  = 0;                                                                      \
+        (*queue)->write_count_cache = 0;                                                                      \
+                                                                                                              \
+        return spsc_fifo_alloc_success;                                                                       \
+    }                                                                                                         \
+                                                                                                              \
+    static inline void name##_free(name **queue) {                                                            \
+        if (*queue == NULL) {                                                                                 \
+            return;                                                                                           \
+        }                                                                                                     \
+                                                                                                              \
+        SPSC_FIFO_FREE((*queue)->mem);                                                                        \
+        *queue = NULL;                                                                                        \
+    }                                                                                                         \
+                                                                                                              \
+    static inline T *name##_emplace(name *queue) {                                                            \
+        const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(queue->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        if (write_count - queue->read_count_cache == queue->capacity) {                                       \
+            queue->read_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(queue->read_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE); \
+            if (write_count - queue->read_count_cache == queue->capacity) {                                   \
+                return NULL;                                                                                  \
+            }                                                                                                 \
+        }                                                                                                     \
+        return &(queue->slots[write_count & queue->mask]);                                                    \
+    }                                                                                                         \
+                                                                                                              \
+    static inline void name##_commit(name *queue) {                                                           \
+        const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(queue->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        SPSC_FIFO_ATOMIC_STORE(&(queue->write_count), write_count + 1, SPSC_FIFO_MEMORY_ORDER_RELEASE);       \
+    }                                                                                                         \
+                                                                                                              \
+    static inline bool name##_push(name *queue, const T *value) {                                             \
+        T *slot = name##_emplace(queue);                                                                      \
+        if (slot == NULL) {                                                                                   \
+            return false;                                                                                     \
+        }                                                                                                     \
+        *slot = *value;                                                                                       \
+        name##_commit(queue);                                                                                 \
+        return true;                                                                                          \
+    }                                                                                                         \
+                                                                                                              \
+    static inline T *name##_front(name *queue) {                                                              \
+        const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(queue->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        if (read_count == queue->write_count_cache) {                                                         \
+            queue->write_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(queue->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE); \
+            if (read_count == queue->write_count_cache) {                                                     \
+                return NULL;                                                                                  \
+            }                                                                                                 \
+        }                                                                                                     \
+        return &(queue->slots[read_count & queue->mask]);                                                     \
+    }                                                                                                         \
+                                                                                                              \
+    static inline void name##_pop(name *queue) {                                                              \
+        const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(queue->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED); \
+        SPSC_FIFO_ATOMIC_STORE(&(queue->read_count), read_count + 1, SPSC_FIFO_MEMORY_ORDER_RELEASE);         \
+    }                                                                                                         \
+                                                                                                              \
+    static inline bool name##_is_empty(name *queue) {                                                         \
+        return name##_front(queue) == NULL;                                                                   \
+    }                                                                                                         \
+                                                                                                              \
+    static inline bool name##_is_full(name *queue) {                                                          \
+        return name##_emplace(queue) == NULL;                                                                 \
+    }                                                                                                         \
+                                                                                                              \
+    typedef int name##_require_semicolon
+
+#endif //__cplusplus
+
+#endif //SPSC_FIFO_H
+
+#ifdef SPSC_FIFO_IMPLEMENTATION
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uintptr_t spsc_fifo_uptr;
+
+#undef SPSC_FIFO_UTIL
+#define SPSC_FIFO_UTIL static inline
+
+#undef SPSC_FIFO_IMPL
+#ifdef SPSC_FIFO_STATIC
+    #define SPSC_FIFO_IMPL static inline
+#else
+    #define SPSC_FIFO_IMPL extern inline
+#endif
+
+#undef SPSC_FIFO_IGNORE
+#define SPSC_FIFO_IGNORE(x) (void)(x)
+
+#ifndef SPSC_FIFO_ASSERT
+#define SPSC_FIFO_ASSERT(expr) assert(expr)
+#endif
+
+#ifndef SPSC_FIFO_DEFAULT_BUF_ALIGNMENT
+#define SPSC_FIFO_DEFAULT_BUF_ALIGNMENT _Alignof(max_align_t)
+#endif
+
+#ifndef SPSC_FIFO_SEG_CACHE
+#define SPSC_FIFO_SEG_CACHE 4
+#endif
+
+#undef SPSC_FIFO_POSIX
+#undef SPSC_FIFO_LINUX
+#if (defined(__unix__) || defined(__APPLE__)) && (!defined(__STRICT_ANSI__) || defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE))
+#define SPSC_FIFO_POSIX
+#ifdef __linux__
+#define SPSC_FIFO_LINUX
+#endif
+#endif
+
+#ifdef SPSC_FIFO_POSIX
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#endif
+
+#undef SPSC_FIFO_SHM
+#if defined(SPSC_FIFO_POSIX) && !defined(SPSC_FIFO_NO_SHM)
+#define SPSC_FIFO_SHM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#undef SPSC_FIFO_MIRRORED_BUF
+#if defined(SPSC_FIFO_LINUX) && !defined(SPSC_FIFO_NO_MMAP)
+#define SPSC_FIFO_MIRRORED_BUF
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#undef SPSC_FIFO_MAPPED_BUF
+#if defined(SPSC_FIFO_POSIX) && !defined(SPSC_FIFO_NO_MMAP)
+#define SPSC_FIFO_MAPPED_BUF
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef SPSC_FIFO_LINUX
+#include <sys/syscall.h>
+#endif
+#endif
+
+#ifdef SPSC_FIFO_COPY_KERNELS
+#ifndef SPSC_FIFO_STREAM_THRESHOLD
+#define SPSC_FIFO_STREAM_THRESHOLD 65536
+#endif
+#ifndef SPSC_FIFO_PREFETCH_BYTES
+#define SPSC_FIFO_PREFETCH_BYTES 256
+#endif
+#undef SPSC_FIFO_X86_KERNELS
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPSC_FIFO_X86_KERNELS
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(SPSC_FIFO_EVENTFD) && defined(SPSC_FIFO_LINUX)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#ifdef SPSC_FIFO_TRACE
+#include <time.h>
+
+#ifndef SPSC_FIFO_TRACE_RATE
+#define SPSC_FIFO_TRACE_RATE 1024
+#endif
+
+#undef SPSC_FIFO_TRACE_STAMPS
+#define SPSC_FIFO_TRACE_STAMPS 64
+#endif
+
+#ifdef SPSC_FIFO_WAIT
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#ifdef SPSC_FIFO_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifndef SPSC_FIFO_SPIN_COUNT
+#define SPSC_FIFO_SPIN_COUNT 1024
+#endif
+
+#undef SPSC_FIFO_CPU_RELAX
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define SPSC_FIFO_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__GNUC__) && defined(__aarch64__)
+    #define SPSC_FIFO_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+    #define SPSC_FIFO_CPU_RELAX() ((void)0)
+#endif
+#endif
+
 #undef SPSC_FIFO_THREAD_SAFETY_DEBUG
 #ifndef SPSC_FIFO_NDEBUG
 #define SPSC_FIFO_THREAD_SAFETY_DEBUG
 #include <threads.h>
 #endif
 
+enum spsc_fifo_kind {
+    spsc_fifo_kind_heap = 0, /* header and buffer in one SPSC_FIFO_ALLOC block */
+    spsc_fifo_kind_mirrored, /* header from SPSC_FIFO_ALLOC, buffer mapped twice */
+    spsc_fifo_kind_shm,      /* header and buffer in a shared memory mapping */
+    spsc_fifo_kind_mapped,   /* header from SPSC_FIFO_ALLOC, buffer in an anonymous mapping (spsc_fifo_alloc_ex) */
+    spsc_fifo_kind_file      /* header and buffer in a shared file mapping (spsc_fifo_file_open) */
+};
+
+/* Fields are grouped by owner, each group starting on its own cache line: the first line is written only
+   during allocation/binding and is read-mostly afterwards, the producer line is written only by the producer
+   and the consumer line only by the consumer. Each side keeps a private copy of the opposite counter next to
+   its own, and only reloads the shared one when that copy can't cover the whole request.
+   buf and the backing allocation are stored relative to the header so it stays valid when mapped at different
+   addresses in different processes. The only absolute address is group, which spsc_fifo_group_add never sets on
+   a shared FIFO. Thread binding is only ever checked by the side that bound itself, so it is meaningful in shared
+   memory as well. */
 struct spsc_fifo {
+    spsc_fifo_uptr buf_offset; /* buf - header, modulo pointer width */
+    spsc_fifo_uptr mem_offset; /* header - start of the allocation/mapping holding it */
+    spsc_fifo_usize capacity;
+    spsc_fifo_usize mask;
+    spsc_fifo_usize span; /* bytes addressable contiguously from buf, 2 * capacity when mirrored */
+    spsc_fifo_usize record_alignment;
+    size_t map_len; /* buffer mapping length for spsc_fifo_kind_mapped, whole mapping for spsc_fifo_kind_file */
+    spsc_fifo_usize sync_interval; /* published bytes between checkpoints of a file-backed FIFO, 0 for none */
+    struct spsc_fifo_group *group; /* fan-in group signalled on publish, NULL if none */
+    spsc_fifo_usize group_index;
+    SPSC_FIFO_ATOMIC(bool) closed; /* set once by either side, see spsc_fifo_close_write/spsc_fifo_close_read */
+#ifdef SPSC_FIFO_EVENTFD
+    int read_fd;  /* signalled for the consumer, -1 if not enabled */
+    int write_fd; /* signalled for the producer */
+#endif
+    bool record_contiguous;
+    unsigned char kind;
+    unsigned char alloc_flags;
 #ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
     bool producer_bound;
     bool consumer_bound;
     thrd_t producer_thrd;
     thrd_t consumer_thrd;
 #endif
-    spsc_fifo_usize capacity;
-    spsc_fifo_usize mask;
-    SPSC_FIFO_ATOMIC(spsc_fifo_usize) write_count;
-    spsc_fifo_byte pad1[SPSC_FIFO_CACHE_LINE_SIZE];
-    SPSC_FIFO_ATOMIC(spsc_fifo_usize) read_count;
-    spsc_fifo_byte pad2[SPSC_FIFO_CACHE_LINE_SIZE];
-    spsc_fifo_byte *buf;
+
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) write_count;
+    spsc_fifo_usize write_shadow; /* producer position, ahead of write_count while a batch is pending */
+    spsc_fifo_usize write_batch;
+    spsc_fifo_usize read_count_cache;
+    SPSC_FIFO_ATOMIC(spsc_fifo_usize) lossy_oldest; /* start of the oldest record not yet being overwritten */
+    unsigned long long lossy_index;                 /* sequence number of the next lossy record */
+    SPSC_FIFO_ATOMIC(spsc_fifo_usize) sync_count;   /* write_count at the last checkpoint, stored by either side */
+#ifdef SPSC_FIFO_WAIT
+    SPSC_FIFO_ATOMIC(bool) consumer_waiting; /* set by a parking consumer, checked by the producer on every publish */
+    SPSC_FIFO_ATOMIC(spsc_fifo_usize) consumer_wake; /* futex word the consumer parks on, bumped to wake it */
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+    SPSC_FIFO_ATOMIC(spsc_fifo_usize) consumer_armed; /* amount a consumer arming read_fd waits for, 0 when not armed */
+#endif
+
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) read_count;
+    spsc_fifo_usize read_shadow; /* consumer position, ahead of read_count while a batch is pending */
+    spsc_fifo_usize read_batch;
+    spsc_fifo_usize write_count_cache;
+    unsigned long long lossy_next; /* sequence number expected next */
+    unsigned long long lossy_lost_records;
+    unsigned long long lossy_lost_bytes;
+#ifdef SPSC_FIFO_WAIT
+    SPSC_FIFO_ATOMIC(bool) producer_waiting; /* set by a parking producer, checked by the consumer on every publish */
+    SPSC_FIFO_ATOMIC(spsc_fifo_usize) producer_wake; /* futex word the producer parks on, bumped to wake it */
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+    SPSC_FIFO_ATOMIC(spsc_fifo_usize) producer_armed; /* amount a producer arming write_fd waits for, 0 when not armed */
+#endif
+
+#ifdef SPSC_FIFO_STATS
+    /* Own lines per side, so a monitoring thread reading them never touches the index lines. Only the owning
+       side stores, so updates are plain load + store without read-modify-write. */
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(unsigned long long) stats_bytes_written;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_writes;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_write_full;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_partial_writes;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_write_splits;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_high_water;
+
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(unsigned long long) stats_bytes_read;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_reads;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_read_empty;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_partial_reads;
+    SPSC_FIFO_ATOMIC(unsigned long long) stats_read_splits;
+#endif
+
+#ifdef SPSC_FIFO_TRACE
+    /* Stamps of sampled writes travel to the consumer through a small ring of their own, the producer drops
+       samples rather than wait when it is full. The histogram is stored only by the consumer. */
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) trace_head;
+    unsigned trace_rate;
+    unsigned trace_countdown;
+    SPSC_FIFO_ATOMIC(unsigned long long) trace_dropped;
+    struct spsc_fifo_trace_stamp {
+        spsc_fifo_usize end; /* write_count once the sampled write is in */
+        unsigned long long ns;
+    } trace_stamps[SPSC_FIFO_TRACE_STAMPS];
+
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) trace_tail;
+    spsc_fifo_usize trace_head_cache;
+    SPSC_FIFO_ATOMIC(unsigned long long) trace_samples;
+    SPSC_FIFO_ATOMIC(unsigned long long) trace_buckets[SPSC_FIFO_TRACE_BUCKETS];
+#endif
+};
+
+#undef SPSC_FIFO_GROUP_WORD_BITS
+#define SPSC_FIFO_GROUP_WORD_BITS (sizeof(unsigned long) * 8)
+
+/* The readiness bitmap is the only state written by several threads. Producers set their bit on publish unless
+   it is already set, the consumer clears a bit only after finding that FIFO empty, so each word sees an RMW
+   per empty/non-empty transition rather than per message. */
+struct spsc_fifo_group {
+    spsc_fifo **members;
+    SPSC_FIFO_ATOMIC(unsigned long) *ready; /* on its own cache lines */
+    void *mem;
+    spsc_fifo_usize max_members;
+    spsc_fifo_usize count;
+    spsc_fifo_usize cursor; /* member after the one returned last */
+#ifdef SPSC_FIFO_WAIT
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) epoch; /* bumped to wake the consumer */
+    SPSC_FIFO_ATOMIC(bool) waiting;
+#endif
+};
+
+/* Consumer cursors each fill their own cache line, written only by their consumer and read by the producer
+   when it runs out of space. */
+struct spsc_fifo_bcast_reader {
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) read_count;
+    spsc_fifo_usize write_count_cache;
+#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
+    bool consumer_bound;
+    thrd_t consumer_thrd;
+#endif
+};
+
+/* The producer side is a plain FIFO whose read_count_cache holds the slowest consumer's position as last seen,
+   its own read_count is unused. */
+struct spsc_fifo_bcast {
+    spsc_fifo *ring;
+    struct spsc_fifo_bcast_reader *readers;
+    void *mem;
+    unsigned consumers;
+};
+
+/* next is set once, by the producer after its last write to the segment, so a consumer that finds it set and
+   the segment empty can move on for good. */
+struct spsc_fifo_seg_node {
+    spsc_fifo *ring;
+    SPSC_FIFO_ATOMIC(struct spsc_fifo_seg_node*) next;
+};
+
+/* Drained segments go back to the producer through cache, itself a small SPSC queue running the other way. */
+struct spsc_fifo_seg {
+    spsc_fifo_usize segment_capacity;
+    spsc_fifo_usize soft_cap;
+    spsc_fifo_usize hard_cap;
+    void *mem;
+
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) struct spsc_fifo_seg_node *tail;
+    struct spsc_fifo_seg_node *spare; /* segments taken for a write_n that did not fit */
+    SPSC_FIFO_ATOMIC(spsc_fifo_usize) cache_head;
+
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) struct spsc_fifo_seg_node *head;
+    SPSC_FIFO_ATOMIC(spsc_fifo_usize) cache_tail;
+    struct spsc_fifo_seg_node *cache[SPSC_FIFO_SEG_CACHE];
+
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(spsc_fifo_usize) memory;
 };
 
+#undef SPSC_FIFO_STATS_ADD
+#undef SPSC_FIFO_STATS_MAX
+#ifdef SPSC_FIFO_STATS
+#define SPSC_FIFO_STATS_ADD(fifo_ptr, counter, n)                                                             \
+    SPSC_FIFO_ATOMIC_STORE(&((fifo_ptr)->stats_##counter),                                                    \
+                           SPSC_FIFO_ATOMIC_LOAD(&((fifo_ptr)->stats_##counter), SPSC_FIFO_MEMORY_ORDER_RELAXED) + (n), \
+                           SPSC_FIFO_MEMORY_ORDER_RELAXED)
+#define SPSC_FIFO_STATS_MAX(fifo_ptr, counter, v)                                                             \
+    do {                                                                                                      \
+        if ((unsigned long long)(v) > SPSC_FIFO_ATOMIC_LOAD(&((fifo_ptr)->stats_##counter), SPSC_FIFO_MEMORY_ORDER_RELAXED)) { \
+            SPSC_FIFO_ATOMIC_STORE(&((fifo_ptr)->stats_##counter), (v), SPSC_FIFO_MEMORY_ORDER_RELAXED);      \
+        }                                                                                                     \
+    } while (0)
+#else
+#define SPSC_FIFO_STATS_ADD(fifo_ptr, counter, n) ((void)0)
+#define SPSC_FIFO_STATS_MAX(fifo_ptr, counter, v) ((void)0)
+#endif
+
 #ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
 #define SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo_ptr)                                        \
     do {                                                                                  \
@@ -208,13 +1008,17 @@ struct spsc_fifo {
 #endif
 
 SPSC_FIFO_UTIL bool spsc_fifo_is_pow_2(spsc_fifo_usize x) {
-    return x > 0 && (x & x - 1) == 0;
+    return x > 0 && (x & (x - 1)) == 0;
 }
 
 SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_min(spsc_fifo_usize a, spsc_fifo_usize b) {
     return a < b ? a : b;
 }
 
+SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_max(spsc_fifo_usize a, spsc_fifo_usize b) {
+    return a > b ? a : b;
+}
+
 SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_ceil_pow_2(spsc_fifo_usize min) {
     spsc_fifo_usize pow = 1;
     while (min > pow) {
@@ -223,183 +1027,2434 @@ SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_ceil_pow_2(spsc_fifo_usize min) {
     return pow;
 }
 
+/* Rounds min_capacity up to a power of two, false if that is not representable in spsc_fifo_usize. */
+SPSC_FIFO_UTIL bool spsc_fifo_round_capacity(spsc_fifo_usize min_capacity, spsc_fifo_usize *capacity) {
+    if (min_capacity > ((spsc_fifo_usize)-1 >> 1) + 1) {
+        return false;
+    }
+
+    *capacity = spsc_fifo_is_pow_2(min_capacity) ? min_capacity : spsc_fifo_ceil_pow_2(min_capacity);
+
+    return true;
+}
+
+/* Adds n to an allocation size, false if the result does not fit in size_t. */
+SPSC_FIFO_UTIL bool spsc_fifo_size_add(size_t *size, spsc_fifo_usize n) {
+    if (n > SIZE_MAX - *size) {
+        return false;
+    }
+
+    *size += (size_t)n;
+
+    return true;
+}
+
 SPSC_FIFO_UTIL spsc_fifo_uptr spsc_fifo_align_backward(spsc_fifo_uptr address, spsc_fifo_usize alignment) {
-    return address & ~(alignment - 1);
+    return address & ~((spsc_fifo_uptr)alignment - 1);
 }
 
 SPSC_FIFO_UTIL spsc_fifo_uptr spsc_fifo_align_forward(spsc_fifo_uptr address, spsc_fifo_usize alignment) {
     return spsc_fifo_align_backward(address + (alignment - 1), alignment);
 }
 
-SPSC_FIFO_IMPL int spsc_fifo_alloc(spsc_fifo **fifo, spsc_fifo_usize min_capacity) {
-    return spsc_fifo_aligned_alloc(fifo, min_capacity, SPSC_FIFO_DEFAULT_BUF_ALIGNMENT);
+SPSC_FIFO_UTIL spsc_fifo_byte *spsc_fifo_buf(spsc_fifo *fifo) {
+    return (spsc_fifo_byte*)((spsc_fifo_uptr)fifo + fifo->buf_offset);
 }
 
-SPSC_FIFO_IMPL int spsc_fifo_aligned_alloc(spsc_fifo **fifo, spsc_fifo_usize min_capacity, spsc_fifo_usize buf_alignment) {
-    if (!spsc_fifo_is_pow_2(buf_alignment)) {
-        return spsc_fifo_alloc_inval;
+SPSC_FIFO_UTIL void *spsc_fifo_mem(spsc_fifo *fifo) {
+    return (void*)((spsc_fifo_uptr)fifo - fifo->mem_offset);
+}
+
+#ifdef SPSC_FIFO_COPY_KERNELS
+/* Copies below a cache line as a pair of possibly overlapping fixed-size moves instead of a memcpy call. */
+SPSC_FIFO_UTIL void spsc_fifo_copy_small(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    if (len >= 32) {
+        memcpy(to, from, 32);
+        memcpy(to + len - 32, from + len - 32, 32);
+    } else if (len >= 16) {
+        memcpy(to, from, 16);
+        memcpy(to + len - 16, from + len - 16, 16);
+    } else if (len >= 8) {
+        memcpy(to, from, 8);
+        memcpy(to + len - 8, from + len - 8, 8);
+    } else if (len >= 4) {
+        memcpy(to, from, 4);
+        memcpy(to + len - 4, from + len - 4, 4);
+    } else if (len > 0) {
+        to[0]       = from[0];
+        to[len / 2] = from[len / 2];
+        to[len - 1] = from[len - 1];
     }
+}
 
-    const spsc_fifo_usize capacity = spsc_fifo_is_pow_2(min_capacity) ? min_capacity : spsc_fifo_ceil_pow_2(min_capacity);
+#ifdef SPSC_FIFO_X86_KERNELS
+/* Streaming (non-temporal) stores bypass the producer's cache, the destination is aligned with a plain copy of
+   the head. None of them fence, spsc_fifo_copy_to_buf issues one sfence before the data can be published. */
+__attribute__((target("avx512f")))
+SPSC_FIFO_UTIL void spsc_fifo_stream_avx512(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    const size_t head = spsc_fifo_min((spsc_fifo_usize)((64 - ((spsc_fifo_uptr)to & 63)) & 63), (spsc_fifo_usize)len);
+    memcpy(to, from, head);
+    to += head; from += head; len -= head;
+    for (; len >= 64; to += 64, from += 64, len -= 64) {
+        _mm512_stream_si512((void*)to, _mm512_loadu_si512((const void*)from));
+    }
+    memcpy(to, from, len);
+}
 
-    const spsc_fifo_usize header_size = sizeof(**fifo);
-    const spsc_fifo_usize buf_padding = buf_alignment - 1;
+__attribute__((target("avx2")))
+SPSC_FIFO_UTIL void spsc_fifo_stream_avx2(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    const size_t head = spsc_fifo_min((spsc_fifo_usize)((32 - ((spsc_fifo_uptr)to & 31)) & 31), (spsc_fifo_usize)len);
+    memcpy(to, from, head);
+    to += head; from += head; len -= head;
+    for (; len >= 128; to += 128, from += 128, len -= 128) {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(from));
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(from + 32));
+        const __m256i c = _mm256_loadu_si256((const __m256i*)(from + 64));
+        const __m256i d = _mm256_loadu_si256((const __m256i*)(from + 96));
+        _mm256_stream_si256((__m256i*)(to),      a);
+        _mm256_stream_si256((__m256i*)(to + 32), b);
+        _mm256_stream_si256((__m256i*)(to + 64), c);
+        _mm256_stream_si256((__m256i*)(to + 96), d);
+    }
+    for (; len >= 32; to += 32, from += 32, len -= 32) {
+        _mm256_stream_si256((__m256i*)to, _mm256_loadu_si256((const __m256i*)from));
+    }
+    memcpy(to, from, len);
+}
 
-    *fifo = SPSC_FIFO_ALLOC(header_size + buf_padding + capacity * sizeof(*(*fifo)->buf));
-    if (*fifo == NULL) {
-        return spsc_fifo_alloc_nomem;
+__attribute__((target("sse2")))
+SPSC_FIFO_UTIL void spsc_fifo_stream_sse2(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+    const size_t head = spsc_fifo_min((spsc_fifo_usize)((16 - ((spsc_fifo_uptr)to & 15)) & 15), (spsc_fifo_usize)len);
+    memcpy(to, from, head);
+    to += head; from += head; len -= head;
+    for (; len >= 64; to += 64, from += 64, len -= 64) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(from));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(from + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(from + 32));
+        const __m128i d = _mm_loadu_si128((const __m128i*)(from + 48));
+        _mm_stream_si128((__m128i*)(to),      a);
+        _mm_stream_si128((__m128i*)(to + 16), b);
+        _mm_stream_si128((__m128i*)(to + 32), c);
+        _mm_stream_si128((__m128i*)(to + 48), d);
+    }
+    for (; len >= 16; to += 16, from += 16, len -= 16) {
+        _mm_stream_si128((__m128i*)to, _mm_loadu_si128((const __m128i*)from));
     }
+    memcpy(to, from, len);
+}
+#endif
 
-#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
-    (*fifo)->producer_bound = false;
-    (*fifo)->consumer_bound = false;
+/* Large writes use the widest streaming kernel the running CPU supports, plain memcpy elsewhere. */
+SPSC_FIFO_UTIL void spsc_fifo_stream(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len) {
+#ifdef SPSC_FIFO_X86_KERNELS
+    if (__builtin_cpu_supports("avx512f")) {
+        spsc_fifo_stream_avx512(to, from, len);
+    } else if (__builtin_cpu_supports("avx2")) {
+        spsc_fifo_stream_avx2(to, from, len);
+    } else if (__builtin_cpu_supports("sse2")) {
+        spsc_fifo_stream_sse2(to, from, len);
+    } else {
+        memcpy(to, from, len);
+    }
+#else
+    memcpy(to, from, len);
 #endif
-    (*fifo)->capacity = capacity;
-    (*fifo)->mask     = capacity - 1;
-    SPSC_FIFO_ATOMIC_STORE(&((*fifo)->write_count), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
-    SPSC_FIFO_ATOMIC_STORE(&((*fifo)->read_count),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
-    (*fifo)->buf = (spsc_fifo_byte*)spsc_fifo_align_forward((spsc_fifo_uptr)(*fifo) + header_size, buf_alignment);
+}
 
-    return spsc_fifo_alloc_success;
+SPSC_FIFO_UTIL void spsc_fifo_stream_fence(void) {
+#ifdef SPSC_FIFO_X86_KERNELS
+    _mm_sfence();
+#endif
 }
 
-SPSC_FIFO_IMPL void spsc_fifo_free(spsc_fifo **fifo) {
-    if (*fifo == NULL) {
-        return;
+SPSC_FIFO_UTIL void spsc_fifo_copy(spsc_fifo_byte *to, const spsc_fifo_byte *from, size_t len, bool stream) {
+    if (len < SPSC_FIFO_CACHE_LINE_SIZE) {
+        spsc_fifo_copy_small(to, from, len);
+    } else if (stream) {
+        spsc_fifo_stream(to, from, len);
+    } else {
+        memcpy(to, from, len);
     }
-
-    SPSC_FIFO_FREE(*fifo);
-    *fifo = NULL;
 }
 
-SPSC_FIFO_IMPL void spsc_fifo_reset(spsc_fifo *fifo) {
-    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
-    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+/* Consumer side: pulls the start of the next read region into cache, limited to bytes already published. */
+SPSC_FIFO_UTIL void spsc_fifo_prefetch_read(spsc_fifo *fifo, spsc_fifo_usize read_count) {
+#ifdef __GNUC__
+    const spsc_fifo_usize len = spsc_fifo_min(SPSC_FIFO_PREFETCH_BYTES, fifo->write_count_cache - read_count);
+    const spsc_fifo_usize idx = read_count & fifo->mask;
+    for (spsc_fifo_usize offset = 0; offset < len; offset += SPSC_FIFO_CACHE_LINE_SIZE) {
+        __builtin_prefetch(spsc_fifo_buf(fifo) + ((idx + offset) & fifo->mask), 0, 3);
+    }
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(read_count);
+#endif
 }
+#endif
 
-SPSC_FIFO_IMPL void spsc_fifo_bind_producer(spsc_fifo *fifo) {
-#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
-    fifo->producer_thrd  = thrd_current();
-    fifo->producer_bound = true;
+SPSC_FIFO_UTIL void spsc_fifo_copy_to_buf(spsc_fifo *fifo, spsc_fifo_usize idx, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+    const spsc_fifo_usize l = spsc_fifo_min(len, fifo->span - idx);
+#ifdef SPSC_FIFO_COPY_KERNELS
+    const bool stream = len >= SPSC_FIFO_STREAM_THRESHOLD;
+    spsc_fifo_copy(spsc_fifo_buf(fifo) + idx, from, l, stream);
+    if (l < len) {
+        spsc_fifo_copy(spsc_fifo_buf(fifo), from + l, len - l, stream);
+        SPSC_FIFO_STATS_ADD(fifo, write_splits, 1);
+    }
+    if (stream) {
+        spsc_fifo_stream_fence();
+    }
 #else
-    SPSC_FIFO_IGNORE(fifo);
+    memcpy(spsc_fifo_buf(fifo) + idx, from, l);
+    if (l < len) {
+        memcpy(spsc_fifo_buf(fifo), from + l, len - l);
+        SPSC_FIFO_STATS_ADD(fifo, write_splits, 1);
+    }
 #endif
 }
 
-SPSC_FIFO_IMPL void spsc_fifo_bind_consumer(spsc_fifo *fifo) {
-#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
-    fifo->consumer_thrd  = thrd_current();
-    fifo->consumer_bound = true;
+SPSC_FIFO_UTIL void spsc_fifo_copy_from_buf(spsc_fifo *fifo, spsc_fifo_usize idx, spsc_fifo_byte *to, spsc_fifo_usize len) {
+    const spsc_fifo_usize l = spsc_fifo_min(len, fifo->span - idx);
+#ifdef SPSC_FIFO_COPY_KERNELS
+    spsc_fifo_copy(to, spsc_fifo_buf(fifo) + idx, l, false);
+    if (l < len) {
+        spsc_fifo_copy(to + l, spsc_fifo_buf(fifo), len - l, false);
+        SPSC_FIFO_STATS_ADD(fifo, read_splits, 1);
+    }
 #else
-    SPSC_FIFO_IGNORE(fifo);
+    memcpy(to, spsc_fifo_buf(fifo) + idx, l);
+    if (l < len) {
+        memcpy(to + l, spsc_fifo_buf(fifo), len - l);
+        SPSC_FIFO_STATS_ADD(fifo, read_splits, 1);
+    }
 #endif
 }
 
-SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_read_avail(spsc_fifo *fifo) {
-    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
 
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#ifdef SPSC_FIFO_WAIT
+#ifdef SPSC_FIFO_LINUX
+/* Futexes are 32-bit, 64-bit counters are waited on through the word holding their low half. */
+SPSC_FIFO_UTIL void *spsc_fifo_futex_word(SPSC_FIFO_ATOMIC(spsc_fifo_usize) *addr) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return (unsigned char*)addr + (sizeof(spsc_fifo_usize) - sizeof(unsigned));
+#else
+    return (void*)addr;
+#endif
+}
+#endif
 
-    return write_count - read_count;
+/* Parks the calling thread while *addr still holds expected. Returns false only once the deadline passed,
+   spurious wakeups return true and are handled by re-checking the counters. */
+SPSC_FIFO_UTIL bool spsc_fifo_park(SPSC_FIFO_ATOMIC(spsc_fifo_usize) *addr, spsc_fifo_usize expected, const struct timespec *deadline, bool shared) {
+#ifdef SPSC_FIFO_LINUX
+    const int op = shared ? FUTEX_WAIT_BITSET : FUTEX_WAIT_BITSET_PRIVATE;
+    if (syscall(SYS_futex, spsc_fifo_futex_word(addr), op, (unsigned)expected, deadline, NULL, FUTEX_BITSET_MATCH_ANY) == 0) {
+        return true;
+    }
+    return errno != ETIMEDOUT;
+#else
+    SPSC_FIFO_IGNORE(addr);
+    SPSC_FIFO_IGNORE(expected);
+    SPSC_FIFO_IGNORE(shared);
+    if (deadline != NULL) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec)) {
+            return false;
+        }
+    }
+    sched_yield();
+    return true;
+#endif
 }
 
-SPSC_FIFO_IMPL bool spsc_fifo_is_empty(spsc_fifo *fifo) {
-    return spsc_fifo_read_avail(fifo) == 0;
+SPSC_FIFO_UTIL void spsc_fifo_unpark(SPSC_FIFO_ATOMIC(spsc_fifo_usize) *addr, bool shared) {
+#ifdef SPSC_FIFO_LINUX
+    syscall(SYS_futex, spsc_fifo_futex_word(addr), shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    SPSC_FIFO_IGNORE(addr);
+    SPSC_FIFO_IGNORE(shared);
+#endif
 }
+#endif
 
-SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_skip(spsc_fifo *fifo, spsc_fifo_usize amount) {
-    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+/* Producer side: marks the FIFO ready in its group. The fence pairs with the one in spsc_fifo_group_poll, so
+   either the producer sees its bit cleared and sets it again, or the consumer sees the published count. */
+SPSC_FIFO_UTIL void spsc_fifo_group_signal(struct spsc_fifo_group *group, spsc_fifo_usize index) {
+    SPSC_FIFO_ATOMIC(unsigned long) *word = &(group->ready[index / SPSC_FIFO_GROUP_WORD_BITS]);
+    const unsigned long bit = 1UL << (index % SPSC_FIFO_GROUP_WORD_BITS);
 
+    SPSC_FIFO_ATOMIC_THREAD_FENCE(SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    if (SPSC_FIFO_ATOMIC_LOAD(word, SPSC_FIFO_MEMORY_ORDER_RELAXED) & bit) {
+        return;
+    }
+
+    SPSC_FIFO_ATOMIC_FETCH_OR(word, bit, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+#ifdef SPSC_FIFO_WAIT
+    if (SPSC_FIFO_ATOMIC_LOAD(&(group->waiting), SPSC_FIFO_MEMORY_ORDER_SEQ_CST)) {
+        SPSC_FIFO_ATOMIC_FETCH_ADD(&(group->epoch), 1, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+        spsc_fifo_unpark(&(group->epoch), false);
+    }
+#endif
+}
+
+#ifdef SPSC_FIFO_TRACE
+SPSC_FIFO_UTIL unsigned long long spsc_fifo_trace_now(void) {
+    struct timespec now;
+#ifdef SPSC_FIFO_POSIX
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+SPSC_FIFO_UTIL unsigned spsc_fifo_trace_bucket(unsigned long long ns) {
+    if (ns < (1ULL << SPSC_FIFO_TRACE_SUB_BITS)) {
+        return (unsigned)ns;
+    }
+
+#if defined(__GNUC__)
+    const unsigned exponent = 63u - (unsigned)__builtin_clzll(ns);
+#else
+    unsigned exponent = 0;
+    for (unsigned long long v = ns; v > 1; v >>= 1) {
+        ++exponent;
+    }
+#endif
+    const unsigned shift = exponent - SPSC_FIFO_TRACE_SUB_BITS;
+    return ((shift + 1) << SPSC_FIFO_TRACE_SUB_BITS) + (unsigned)(ns >> shift) - (1u << SPSC_FIFO_TRACE_SUB_BITS);
+}
+
+/* Producer side: stamps every trace_rate-th publish with the end of the range it makes visible. */
+SPSC_FIFO_UTIL void spsc_fifo_trace_write(spsc_fifo *fifo, spsc_fifo_usize write_count) {
+    if (fifo->trace_rate == 0 || --fifo->trace_countdown != 0) {
+        return;
+    }
+    fifo->trace_countdown = fifo->trace_rate;
+
+    const spsc_fifo_usize head = SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_head), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (head - SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_tail), SPSC_FIFO_MEMORY_ORDER_ACQUIRE) == SPSC_FIFO_TRACE_STAMPS) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_dropped),
+                               SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_dropped), SPSC_FIFO_MEMORY_ORDER_RELAXED) + 1,
+                               SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        return;
+    }
+
+    struct spsc_fifo_trace_stamp *stamp = &(fifo->trace_stamps[head % SPSC_FIFO_TRACE_STAMPS]);
+    stamp->end = write_count;
+    stamp->ns  = spsc_fifo_trace_now();
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_head), head + 1, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+}
+
+/* Consumer side: completes the stamps of writes read up to read_count. The clock is read only if one did. */
+SPSC_FIFO_UTIL void spsc_fifo_trace_read(spsc_fifo *fifo, spsc_fifo_usize read_count) {
+    spsc_fifo_usize tail = SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_tail), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (tail == fifo->trace_head_cache) {
+        fifo->trace_head_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_head), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+        if (tail == fifo->trace_head_cache) {
+            return;
+        }
+    }
+
+    unsigned long long now = 0;
+    unsigned long long samples = 0;
+    for (; tail != fifo->trace_head_cache; ++tail) {
+        const struct spsc_fifo_trace_stamp *stamp = &(fifo->trace_stamps[tail % SPSC_FIFO_TRACE_STAMPS]);
+        if ((spsc_fifo_usize)(stamp->end - read_count - 1) < ((spsc_fifo_usize)-1 >> 1)) {
+            break; /* end lies ahead of read_count */
+        }
+
+        if (samples++ == 0) {
+            now = spsc_fifo_trace_now();
+        }
+        SPSC_FIFO_ATOMIC(unsigned long long) *bucket = &(fifo->trace_buckets[spsc_fifo_trace_bucket(now > stamp->ns ? now - stamp->ns : 0)]);
+        SPSC_FIFO_ATOMIC_STORE(bucket, SPSC_FIFO_ATOMIC_LOAD(bucket, SPSC_FIFO_MEMORY_ORDER_RELAXED) + 1, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    }
+
+    if (samples != 0) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_samples),
+                               SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_samples), SPSC_FIFO_MEMORY_ORDER_RELAXED) + samples,
+                               SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_tail), tail, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    }
+}
+#endif
+
+#ifdef SPSC_FIFO_SHM
+/* Writes a file-backed FIFO's mapping back to the file, counters included. */
+SPSC_FIFO_UTIL bool spsc_fifo_file_checkpoint(spsc_fifo *fifo) {
+    return msync(spsc_fifo_mem(fifo), fifo->map_len, MS_SYNC) == 0;
+}
+#endif
+
+#ifdef SPSC_FIFO_EVENTFD
+SPSC_FIFO_UTIL void spsc_fifo_event_signal(int fd) {
+#ifdef SPSC_FIFO_LINUX
+    if (fd >= 0) {
+        const uint64_t one = 1;
+        const ssize_t written = write(fd, &one, sizeof(one));
+        SPSC_FIFO_IGNORE(written);
+    }
+#else
+    SPSC_FIFO_IGNORE(fd);
+#endif
+}
+
+/* Resets the eventfd counter, so a level-triggered poll stops reporting it. */
+SPSC_FIFO_UTIL void spsc_fifo_event_drain(int fd) {
+#ifdef SPSC_FIFO_LINUX
+    uint64_t count;
+    const ssize_t got = read(fd, &count, sizeof(count));
+    SPSC_FIFO_IGNORE(got);
+#else
+    SPSC_FIFO_IGNORE(fd);
+#endif
+}
+#endif
+
+/* Makes bytes up to write_count visible to the consumer. With SPSC_FIFO_WAIT or SPSC_FIFO_EVENTFD the store is
+   sequentially consistent, pairing with the consumer's waiting/armed flag store followed by its write_count
+   reload, so either the consumer sees the new count or the producer sees the flag and bumps the consumer's wake
+   word before waking it - a wakeup can't be lost. An armed read_fd is signaled only once the amount it was armed
+   for is readable; the consumer is idle meanwhile, so read_count is exact here and the armed amount is checked
+   exactly as spsc_fifo_arm_read_fd checks it. */
+SPSC_FIFO_UTIL void spsc_fifo_publish_write(spsc_fifo *fifo, spsc_fifo_usize write_count) {
+#ifdef SPSC_FIFO_TRACE
+    spsc_fifo_trace_write(fifo, write_count); /* stamped first, so it is queued before the consumer can read the range */
+#endif
+#if defined(SPSC_FIFO_WAIT) || defined(SPSC_FIFO_EVENTFD)
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), write_count, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+#else
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), write_count, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+#endif
+#ifdef SPSC_FIFO_WAIT
+    if (SPSC_FIFO_ATOMIC_LOAD(&(fifo->consumer_waiting), SPSC_FIFO_MEMORY_ORDER_SEQ_CST)) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_FETCH_ADD(&(fifo->consumer_wake), 1, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+        spsc_fifo_unpark(&(fifo->consumer_wake), fifo->kind == spsc_fifo_kind_shm);
+    }
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+    const spsc_fifo_usize armed = SPSC_FIFO_ATOMIC_LOAD(&(fifo->consumer_armed), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    if (armed != 0 && write_count - SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED) >= armed) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_armed), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        spsc_fifo_event_signal(fifo->read_fd);
+    }
+#endif
+    if (fifo->group != NULL) {
+        spsc_fifo_group_signal(fifo->group, fifo->group_index);
+    }
+}
+
+/* Makes space up to read_count reusable by the producer, see spsc_fifo_publish_write. */
+SPSC_FIFO_UTIL void spsc_fifo_publish_read(spsc_fifo *fifo, spsc_fifo_usize read_count) {
+#if defined(SPSC_FIFO_WAIT) || defined(SPSC_FIFO_EVENTFD)
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+#else
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+#endif
+#ifdef SPSC_FIFO_WAIT
+    if (SPSC_FIFO_ATOMIC_LOAD(&(fifo->producer_waiting), SPSC_FIFO_MEMORY_ORDER_SEQ_CST)) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_FETCH_ADD(&(fifo->producer_wake), 1, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+        spsc_fifo_unpark(&(fifo->producer_wake), fifo->kind == spsc_fifo_kind_shm);
+    }
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+    const spsc_fifo_usize armed = SPSC_FIFO_ATOMIC_LOAD(&(fifo->producer_armed), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    if (armed != 0 && fifo->capacity - (SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED) - read_count) >= armed) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_armed), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        spsc_fifo_event_signal(fifo->write_fd);
+    }
+#endif
+}
+
+/* Producer side: records the new position and publishes it once write_batch bytes are pending. */
+SPSC_FIFO_UTIL void spsc_fifo_advance_write(spsc_fifo *fifo, spsc_fifo_usize write_count) {
+    SPSC_FIFO_STATS_ADD(fifo, bytes_written, write_count - fifo->write_shadow);
+    SPSC_FIFO_STATS_ADD(fifo, writes, 1);
+    SPSC_FIFO_STATS_MAX(fifo, high_water, write_count - fifo->read_count_cache);
+    fifo->write_shadow = write_count;
+    if (write_count - SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED) >= fifo->write_batch
+#ifdef SPSC_FIFO_WAIT
+        || SPSC_FIFO_ATOMIC_LOAD(&(fifo->consumer_waiting), SPSC_FIFO_MEMORY_ORDER_RELAXED)
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+        || SPSC_FIFO_ATOMIC_LOAD(&(fifo->consumer_armed), SPSC_FIFO_MEMORY_ORDER_RELAXED) != 0
+#endif
+    ) {
+        spsc_fifo_publish_write(fifo, write_count);
+    }
+}
+
+/* Consumer side: records the new position and publishes it once read_batch bytes are pending. */
+SPSC_FIFO_UTIL void spsc_fifo_advance_read(spsc_fifo *fifo, spsc_fifo_usize read_count) {
+    SPSC_FIFO_STATS_ADD(fifo, bytes_read, read_count - fifo->read_shadow);
+    SPSC_FIFO_STATS_ADD(fifo, reads, 1);
+    fifo->read_shadow = read_count;
+#ifdef SPSC_FIFO_COPY_KERNELS
+    spsc_fifo_prefetch_read(fifo, read_count);
+#endif
+#ifdef SPSC_FIFO_TRACE
+    spsc_fifo_trace_read(fifo, read_count);
+#endif
+    if (read_count - SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED) >= fifo->read_batch
+#ifdef SPSC_FIFO_WAIT
+        || SPSC_FIFO_ATOMIC_LOAD(&(fifo->producer_waiting), SPSC_FIFO_MEMORY_ORDER_RELAXED)
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+        || SPSC_FIFO_ATOMIC_LOAD(&(fifo->producer_armed), SPSC_FIFO_MEMORY_ORDER_RELAXED) != 0
+#endif
+    ) {
+        spsc_fifo_publish_read(fifo, read_count);
+    }
+}
+
+SPSC_FIFO_UTIL void spsc_fifo_flush_pending_write(spsc_fifo *fifo) {
+    if (fifo->write_shadow != SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED)) {
+        spsc_fifo_publish_write(fifo, fifo->write_shadow);
+    }
+}
+
+SPSC_FIFO_UTIL void spsc_fifo_flush_pending_read(spsc_fifo *fifo) {
+    if (fifo->read_shadow != SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED)) {
+        spsc_fifo_publish_read(fifo, fifo->read_shadow);
+    }
+}
+
+/* Consumer side: returns readable bytes, reloading write_count only if the cached copy has fewer than want.
+   want must be the whole amount the caller is after (1 only to test for empty), anything less lets a stale copy
+   cut the request short. If the FIFO still looks short, pending reads are published so a producer waiting for
+   space can progress. */
+SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_readable(spsc_fifo *fifo, spsc_fifo_usize read_count, spsc_fifo_usize want) {
+    spsc_fifo_usize read_avail = fifo->write_count_cache - read_count;
+    if (read_avail < want) {
+        fifo->write_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+        read_avail = fifo->write_count_cache - read_count;
+        if (read_avail < want) {
+            spsc_fifo_flush_pending_read(fifo);
+        }
+    }
+    return read_avail;
+}
+
+/* Producer side: returns writable bytes, reloading read_count only if the cached copy has fewer than want.
+   want must be the whole amount the caller is after (1 only to test for full), anything less lets a stale copy
+   cut the request short. If the FIFO still looks short, pending writes are published so the consumer can drain
+   them. */
+SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_writable(spsc_fifo *fifo, spsc_fifo_usize write_count, spsc_fifo_usize want) {
+    spsc_fifo_usize write_avail = fifo->capacity - (write_count - fifo->read_count_cache);
+    if (write_avail < want) {
+        fifo->read_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+        write_avail = fifo->capacity - (write_count - fifo->read_count_cache);
+        if (write_avail < want) {
+            spsc_fifo_flush_pending_write(fifo);
+        }
+    }
+    return write_avail;
+}
+
+SPSC_FIFO_UTIL void spsc_fifo_init(spsc_fifo *fifo, void *mem, spsc_fifo_byte *buf, spsc_fifo_usize capacity, enum spsc_fifo_kind kind) {
+#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
+    fifo->producer_bound = false;
+    fifo->consumer_bound = false;
+#endif
+    fifo->kind     = (unsigned char)kind;
+    fifo->map_len  = 0;
+    fifo->sync_interval = 0;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->sync_count), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->group    = NULL;
+    fifo->group_index = 0;
+    fifo->alloc_flags = 0;
+    fifo->capacity = capacity;
+    fifo->mask     = capacity - 1;
+    fifo->span     = kind == spsc_fifo_kind_mirrored ? 2 * capacity : capacity;
+    fifo->record_alignment  = SPSC_FIFO_RECORD_HEADER_SIZE;
+    fifo->record_contiguous = false;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->closed), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->write_shadow      = 0;
+    fifo->write_batch       = 0;
+    fifo->read_count_cache  = 0;
+    fifo->read_shadow       = 0;
+    fifo->read_batch        = 0;
+    fifo->write_count_cache = 0;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->lossy_oldest), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->lossy_index        = 0;
+    fifo->lossy_next         = 0;
+    fifo->lossy_lost_records = 0;
+    fifo->lossy_lost_bytes   = 0;
+#ifdef SPSC_FIFO_WAIT
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_wake), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_wake), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+    fifo->read_fd  = -1;
+    fifo->write_fd = -1;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_armed), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_armed), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#endif
+#ifdef SPSC_FIFO_STATS
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_bytes_written),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_writes),         0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_write_full),     0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_partial_writes), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_write_splits),   0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_high_water),     0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_bytes_read),     0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_reads),          0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_read_empty),     0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_partial_reads),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->stats_read_splits),    0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#endif
+#ifdef SPSC_FIFO_TRACE
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_head), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_tail), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->trace_rate       = SPSC_FIFO_TRACE_RATE;
+    fifo->trace_countdown  = SPSC_FIFO_TRACE_RATE;
+    fifo->trace_head_cache = 0;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_dropped), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_samples), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    for (unsigned i = 0; i < SPSC_FIFO_TRACE_BUCKETS; ++i) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_buckets[i]), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    }
+#endif
+    fifo->buf_offset = (spsc_fifo_uptr)buf - (spsc_fifo_uptr)fifo;
+    fifo->mem_offset = (spsc_fifo_uptr)fifo - (spsc_fifo_uptr)mem;
+}
+
+#undef SPSC_FIFO_RECORD_PAD
+#define SPSC_FIFO_RECORD_PAD ((spsc_fifo_usize)-1)
+
+/* Bytes a record with len payload bytes occupies in the buffer, header and alignment padding included. */
+SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_record_stride(spsc_fifo *fifo, spsc_fifo_usize len) {
+    return (spsc_fifo_usize)spsc_fifo_align_forward(SPSC_FIFO_RECORD_HEADER_SIZE + len, fifo->record_alignment);
+}
+
+/* Consumer side: locates the next record, stepping the local read_count over a wrap padding marker. Records are
+   always aligned to at least the header size, so a header never straddles the end of the buffer. Nothing is
+   committed here, see spsc_fifo_record_release_pad for a marker with no record behind it yet. */
+SPSC_FIFO_UTIL bool spsc_fifo_record_front(spsc_fifo *fifo, spsc_fifo_usize *read_count, spsc_fifo_usize *len) {
+    if (spsc_fifo_readable(fifo, *read_count, SPSC_FIFO_RECORD_HEADER_SIZE) == 0) {
+        return false;
+    }
+
+    memcpy(len, spsc_fifo_buf(fifo) + (*read_count & fifo->mask), SPSC_FIFO_RECORD_HEADER_SIZE);
+    if (*len != SPSC_FIFO_RECORD_PAD) {
+        return true;
+    }
+
+    *read_count += fifo->capacity - (*read_count & fifo->mask);
+    if (spsc_fifo_readable(fifo, *read_count, SPSC_FIFO_RECORD_HEADER_SIZE) == 0) {
+        return false;
+    }
+
+    memcpy(len, spsc_fifo_buf(fifo) + (*read_count & fifo->mask), SPSC_FIFO_RECORD_HEADER_SIZE);
+    return true;
+}
+
+/* Consumer side: after spsc_fifo_record_front found no record, releases a padding marker it stepped over. The
+   producer publishes a marker alone only when the record can't fit behind it, and then waits for that space. */
+SPSC_FIFO_UTIL void spsc_fifo_record_release_pad(spsc_fifo *fifo, spsc_fifo_usize read_count) {
+    if (read_count != fifo->read_shadow) {
+        spsc_fifo_advance_read(fifo, read_count);
+        spsc_fifo_flush_pending_read(fifo);
+    }
+}
+
+/* Lossy record prefix. pos is the write_count the record starts at, which differs from the consumer's position
+   if the bytes there belong to another lap. */
+struct spsc_fifo_lossy_header {
+    spsc_fifo_usize pos;
+    spsc_fifo_usize len;
+    unsigned long long index;
+};
+
+SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_lossy_stride(spsc_fifo_usize len) {
+    return (spsc_fifo_usize)spsc_fifo_align_forward(sizeof(struct spsc_fifo_lossy_header) + len, SPSC_FIFO_RECORD_HEADER_SIZE);
+}
+
+SPSC_FIFO_UTIL void spsc_fifo_lossy_header_at(spsc_fifo *fifo, spsc_fifo_usize pos, struct spsc_fifo_lossy_header *header) {
+    spsc_fifo_ring_get(spsc_fifo_buf(fifo), fifo->capacity, pos & fifo->mask, (spsc_fifo_byte*)header, sizeof(*header));
+}
+
+#ifdef SPSC_FIFO_SHM
+#undef SPSC_FIFO_SHM_MAGIC
+#define SPSC_FIFO_SHM_MAGIC 0x53505343u /* "SPSC" */
+#undef SPSC_FIFO_SHM_VERSION
+#define SPSC_FIFO_SHM_VERSION 1u
+
+/* Prefix of a shared mapping, followed by the FIFO header and the buffer. header_size catches processes built
+   with different options (cache line size, debugging, ...), which would disagree on the header layout. */
+struct spsc_fifo_shm_header {
+    SPSC_FIFO_ATOMIC(uint32_t) magic; /* stored last by the creator */
+    uint32_t version;
+    uint32_t header_size;
+    spsc_fifo_usize capacity;
+    uint64_t size;
+};
+
+SPSC_FIFO_UTIL size_t spsc_fifo_shm_fifo_offset(void) {
+    return (size_t)spsc_fifo_align_forward(sizeof(struct spsc_fifo_shm_header), _Alignof(spsc_fifo));
+}
+
+SPSC_FIFO_UTIL size_t spsc_fifo_shm_buf_offset(void) {
+    return (size_t)spsc_fifo_align_forward(spsc_fifo_shm_fifo_offset() + sizeof(spsc_fifo), SPSC_FIFO_CACHE_LINE_SIZE);
+}
+
+SPSC_FIFO_UTIL bool spsc_fifo_shm_header_valid(struct spsc_fifo_shm_header *header, size_t size) {
+    return SPSC_FIFO_ATOMIC_LOAD(&(header->magic), SPSC_FIFO_MEMORY_ORDER_ACQUIRE) == SPSC_FIFO_SHM_MAGIC &&
+           header->version == SPSC_FIFO_SHM_VERSION &&
+           header->header_size == sizeof(spsc_fifo) &&
+           spsc_fifo_is_pow_2(header->capacity) &&
+           header->size == spsc_fifo_shm_buf_offset() + header->capacity &&
+           header->size == (uint64_t)size;
+}
+
+/* Drops what only meant something to the process that had the file open before: thread bindings, group
+   membership, parked peers, batch sizes and positions batched but never published. Batched reads are delivered
+   again. False if the stored counters are more than capacity apart, which no valid FIFO reaches. */
+SPSC_FIFO_UTIL bool spsc_fifo_file_recover(spsc_fifo *fifo) {
+    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (write_count - read_count > fifo->capacity) {
+        return false;
+    }
+
+#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
+    fifo->producer_bound = false;
+    fifo->consumer_bound = false;
+#endif
+    fifo->group       = NULL;
+    fifo->group_index = 0;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->closed), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->write_shadow      = write_count;
+    fifo->write_batch       = 0;
+    fifo->read_count_cache  = read_count;
+    fifo->read_shadow       = read_count;
+    fifo->read_batch        = 0;
+    fifo->write_count_cache = write_count;
+#ifdef SPSC_FIFO_WAIT
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_wake), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_wake), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+    fifo->read_fd  = -1;
+    fifo->write_fd = -1;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_armed), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_armed), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#endif
+
+    return true;
+}
+
+SPSC_FIFO_UTIL void spsc_fifo_shm_unmap(spsc_fifo *fifo) {
+    struct spsc_fifo_shm_header *header = spsc_fifo_mem(fifo);
+    munmap(header, (size_t)header->size);
+}
+#endif
+
+#ifdef SPSC_FIFO_MIRRORED_BUF
+/* Maps the same memfd pages twice back to back, so any span of up to size bytes starting inside the first
+   mapping is virtually contiguous. Returns NULL if any step is unsupported by the running kernel. */
+SPSC_FIFO_UTIL spsc_fifo_byte *spsc_fifo_map_mirrored(size_t size) {
+    if (size > SIZE_MAX / 2) {
+        return NULL;
+    }
+
+    const int fd = (int)syscall(SYS_memfd_create, "spsc-fifo", 1U /* MFD_CLOEXEC */);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    spsc_fifo_byte *buf = NULL;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        spsc_fifo_byte *addr = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr != MAP_FAILED) {
+            if (mmap(addr,        size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+                mmap(addr + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED) {
+                buf = addr;
+            } else {
+                munmap(addr, 2 * size);
+            }
+        }
+    }
+
+    close(fd);
+    return buf;
+}
+#endif
+
+#ifdef SPSC_FIFO_MAPPED_BUF
+/* Size of explicit/transparent huge pages, 2 MiB unless the kernel reports otherwise. */
+SPSC_FIFO_UTIL size_t spsc_fifo_huge_page_size(void) {
+    size_t size = 2 * 1024 * 1024;
+#ifdef SPSC_FIFO_LINUX
+    FILE *meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo != NULL) {
+        char line[128];
+        unsigned long kib;
+        while (fgets(line, sizeof(line), meminfo) != NULL) {
+            if (sscanf(line, "Hugepagesize: %lu kB", &kib) == 1) {
+                size = (size_t)kib * 1024;
+                break;
+            }
+        }
+        fclose(meminfo);
+    }
+#endif
+    return size;
+}
+
+/* Anonymous mapping of len bytes starting at a multiple of alignment (a power of two, at least page_size).
+   The mapping is over-sized by the alignment and the excess is unmapped from both ends. */
+SPSC_FIFO_UTIL spsc_fifo_byte *spsc_fifo_map_anon(size_t len, size_t alignment, size_t page_size) {
+    const size_t extra = alignment - page_size;
+    if (len > SIZE_MAX - extra) {
+        return NULL;
+    }
+
+    spsc_fifo_byte *addr = mmap(NULL, len + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    spsc_fifo_byte *buf = (spsc_fifo_byte*)spsc_fifo_align_forward((spsc_fifo_uptr)addr, (spsc_fifo_usize)alignment);
+    if (buf != addr) {
+        munmap(addr, (size_t)(buf - addr));
+    }
+    if (addr + extra != buf) {
+        munmap(buf + len, (size_t)(addr + extra - buf));
+    }
+
+    return buf;
+}
+
+/* Binds not yet touched pages to a NUMA node, false where mbind is unavailable or the node is unknown. */
+SPSC_FIFO_UTIL bool spsc_fifo_bind_node(void *addr, size_t len, int node) {
+#if defined(SPSC_FIFO_LINUX) && defined(SYS_mbind)
+    unsigned long nodemask[16] = {0};
+    const size_t bits = sizeof(*nodemask) * 8;
+    if ((size_t)node >= bits * (sizeof(nodemask) / sizeof(*nodemask))) {
+        return false;
+    }
+
+    nodemask[(size_t)node / bits] = 1UL << ((size_t)node % bits);
+    return syscall(SYS_mbind, addr, len, 2 /* MPOL_BIND */, nodemask, bits * (sizeof(nodemask) / sizeof(*nodemask)), 0) == 0;
+#else
+    SPSC_FIFO_IGNORE(addr);
+    SPSC_FIFO_IGNORE(len);
+    SPSC_FIFO_IGNORE(node);
+    return false;
+#endif
+}
+#endif
+
+SPSC_FIFO_IMPL int spsc_fifo_alloc(spsc_fifo **fifo, spsc_fifo_usize min_capacity) {
+    return spsc_fifo_aligned_alloc(fifo, min_capacity, SPSC_FIFO_DEFAULT_BUF_ALIGNMENT);
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_aligned_alloc(spsc_fifo **fifo, spsc_fifo_usize min_capacity, spsc_fifo_usize buf_alignment) {
+    spsc_fifo_usize capacity;
+    if (!spsc_fifo_is_pow_2(buf_alignment) || !spsc_fifo_round_capacity(min_capacity, &capacity)) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    const size_t header_size = sizeof(**fifo);
+
+    size_t size = _Alignof(spsc_fifo) - 1 + header_size;
+    if (!spsc_fifo_size_add(&size, buf_alignment - 1) || !spsc_fifo_size_add(&size, capacity)) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    void *mem = SPSC_FIFO_ALLOC(size);
+    if (mem == NULL) {
+        return spsc_fifo_alloc_nomem;
+    }
+
+    *fifo = (spsc_fifo*)spsc_fifo_align_forward((spsc_fifo_uptr)mem, _Alignof(spsc_fifo));
+    spsc_fifo_byte *buf = (spsc_fifo_byte*)spsc_fifo_align_forward((spsc_fifo_uptr)(*fifo) + header_size, buf_alignment);
+    spsc_fifo_init(*fifo, mem, buf, capacity, spsc_fifo_kind_heap);
+
+    return spsc_fifo_alloc_success;
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_mmap_alloc(spsc_fifo **fifo, spsc_fifo_usize min_capacity) {
+#ifdef SPSC_FIFO_MIRRORED_BUF
+    const long page_size = sysconf(_SC_PAGESIZE);
+    spsc_fifo_usize capacity;
+    if (!spsc_fifo_round_capacity(min_capacity, &capacity)) {
+        return spsc_fifo_alloc_inval;
+    }
+    if (page_size > 0 && spsc_fifo_is_pow_2((spsc_fifo_usize)page_size) && capacity < (spsc_fifo_usize)page_size) {
+        capacity = (spsc_fifo_usize)page_size;
+    }
+
+    if (page_size > 0 && capacity % (spsc_fifo_usize)page_size == 0 && capacity <= ((spsc_fifo_usize)-1) / 2 &&
+        (spsc_fifo_usize)(size_t)capacity == capacity) {
+        spsc_fifo_byte *buf = spsc_fifo_map_mirrored(capacity);
+        if (buf != NULL) {
+            void *mem = SPSC_FIFO_ALLOC(_Alignof(spsc_fifo) - 1 + sizeof(**fifo));
+            if (mem == NULL) {
+                munmap(buf, 2 * (size_t)capacity);
+                return spsc_fifo_alloc_nomem;
+            }
+
+            *fifo = (spsc_fifo*)spsc_fifo_align_forward((spsc_fifo_uptr)mem, _Alignof(spsc_fifo));
+            spsc_fifo_init(*fifo, mem, buf, capacity, spsc_fifo_kind_mirrored);
+
+            return spsc_fifo_alloc_success;
+        }
+    }
+#endif
+
+    return spsc_fifo_aligned_alloc(fifo, min_capacity, SPSC_FIFO_DEFAULT_BUF_ALIGNMENT);
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_alloc_ex(spsc_fifo **fifo, spsc_fifo_usize min_capacity, const spsc_fifo_alloc_options *options) {
+    const spsc_fifo_usize buf_alignment = options->buf_alignment != 0 ? options->buf_alignment : SPSC_FIFO_DEFAULT_BUF_ALIGNMENT;
+
+#ifdef SPSC_FIFO_MAPPED_BUF
+    spsc_fifo_usize capacity;
+    if (!spsc_fifo_is_pow_2(buf_alignment) || !spsc_fifo_round_capacity(min_capacity, &capacity)) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    const size_t huge_page_size = spsc_fifo_huge_page_size();
+    if (page_size <= 0 || !spsc_fifo_is_pow_2((spsc_fifo_usize)page_size) || capacity > SIZE_MAX - huge_page_size) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    unsigned applied = 0;
+    spsc_fifo_byte *buf = NULL;
+    size_t map_len = 0;
+
+#ifdef MAP_HUGETLB
+    if ((options->flags & spsc_fifo_alloc_flag_hugetlb) && buf_alignment <= huge_page_size) {
+        map_len = (size_t)spsc_fifo_align_forward(capacity, (spsc_fifo_usize)huge_page_size);
+        buf = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (buf == MAP_FAILED) {
+            buf = NULL;
+        } else {
+            applied |= spsc_fifo_alloc_flag_hugetlb;
+        }
+    }
+#endif
+
+    if (buf == NULL) {
+        size_t alignment = (size_t)page_size;
+        if (buf_alignment > alignment) {
+            alignment = buf_alignment;
+        }
+        if ((options->flags & spsc_fifo_alloc_flag_thp) && capacity >= huge_page_size && huge_page_size > alignment) {
+            alignment = huge_page_size;
+        }
+
+        map_len = (size_t)spsc_fifo_align_forward(capacity, (spsc_fifo_usize)page_size);
+        buf = spsc_fifo_map_anon(map_len, alignment, (size_t)page_size);
+        if (buf == NULL) {
+            return spsc_fifo_alloc_nomem;
+        }
+
+#ifdef MADV_HUGEPAGE
+        if ((options->flags & spsc_fifo_alloc_flag_thp) && madvise(buf, map_len, MADV_HUGEPAGE) == 0) {
+            applied |= spsc_fifo_alloc_flag_thp;
+        }
+#endif
+    }
+
+    /* Placement has to be decided before the first touch, locking and prefaulting then fault pages in. */
+    if (options->numa_node >= 0 && spsc_fifo_bind_node(buf, map_len, options->numa_node)) {
+        applied |= spsc_fifo_alloc_flag_numa;
+    }
+
+    if ((options->flags & spsc_fifo_alloc_flag_mlock) && mlock(buf, map_len) == 0) {
+        applied |= spsc_fifo_alloc_flag_mlock;
+    }
+
+    if (options->flags & spsc_fifo_alloc_flag_prefault) {
+        for (size_t offset = 0; offset < map_len; offset += (size_t)page_size) {
+            ((volatile spsc_fifo_byte*)buf)[offset] = 0;
+        }
+        applied |= spsc_fifo_alloc_flag_prefault;
+    }
+
+    void *mem = SPSC_FIFO_ALLOC(_Alignof(spsc_fifo) - 1 + sizeof(**fifo));
+    if (mem == NULL) {
+        munmap(buf, map_len);
+        return spsc_fifo_alloc_nomem;
+    }
+
+    *fifo = (spsc_fifo*)spsc_fifo_align_forward((spsc_fifo_uptr)mem, _Alignof(spsc_fifo));
+    spsc_fifo_init(*fifo, mem, buf, capacity, spsc_fifo_kind_mapped);
+    (*fifo)->map_len     = map_len;
+    (*fifo)->alloc_flags = (unsigned char)applied;
+
+    return spsc_fifo_alloc_success;
+#else
+    return spsc_fifo_aligned_alloc(fifo, min_capacity, buf_alignment);
+#endif
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_shm_create(spsc_fifo **fifo, const char *name, spsc_fifo_usize min_capacity) {
+#ifdef SPSC_FIFO_SHM
+    spsc_fifo_usize capacity;
+    size_t size = spsc_fifo_shm_buf_offset();
+    if (!spsc_fifo_round_capacity(min_capacity, &capacity) || !spsc_fifo_size_add(&size, capacity)) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return spsc_fifo_alloc_syserr;
+    }
+
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return spsc_fifo_alloc_syserr;
+    }
+
+    struct spsc_fifo_shm_header *header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        shm_unlink(name);
+        return spsc_fifo_alloc_syserr;
+    }
+
+    header->version     = SPSC_FIFO_SHM_VERSION;
+    header->header_size = sizeof(spsc_fifo);
+    header->capacity    = capacity;
+    header->size        = size;
+
+    *fifo = (spsc_fifo*)((spsc_fifo_byte*)header + spsc_fifo_shm_fifo_offset());
+    spsc_fifo_init(*fifo, header, (spsc_fifo_byte*)header + spsc_fifo_shm_buf_offset(), capacity, spsc_fifo_kind_shm);
+
+    SPSC_FIFO_ATOMIC_STORE(&(header->magic), SPSC_FIFO_SHM_MAGIC, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+
+    return spsc_fifo_alloc_success;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(name);
+    SPSC_FIFO_IGNORE(min_capacity);
+    return spsc_fifo_alloc_syserr;
+#endif
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_shm_attach(spsc_fifo **fifo, const char *name) {
+#ifdef SPSC_FIFO_SHM
+    const int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return spsc_fifo_alloc_syserr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return spsc_fifo_alloc_syserr;
+    }
+
+    if ((size_t)st.st_size < spsc_fifo_shm_buf_offset()) {
+        close(fd);
+        return spsc_fifo_alloc_mismatch;
+    }
+
+    struct spsc_fifo_shm_header *header = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        return spsc_fifo_alloc_syserr;
+    }
+
+    if (!spsc_fifo_shm_header_valid(header, (size_t)st.st_size)) {
+        munmap(header, (size_t)st.st_size);
+        return spsc_fifo_alloc_mismatch;
+    }
+
+    *fifo = (spsc_fifo*)((spsc_fifo_byte*)header + spsc_fifo_shm_fifo_offset());
+
+    return spsc_fifo_alloc_success;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(name);
+    return spsc_fifo_alloc_syserr;
+#endif
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_shm_unlink(const char *name) {
+#ifdef SPSC_FIFO_SHM
+    return shm_unlink(name) == 0;
+#else
+    SPSC_FIFO_IGNORE(name);
+    return false;
+#endif
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_file_open(spsc_fifo **fifo, const char *path, spsc_fifo_usize min_capacity, spsc_fifo_usize sync_interval) {
+#ifdef SPSC_FIFO_SHM
+    spsc_fifo_usize capacity;
+    size_t size = spsc_fifo_shm_buf_offset();
+    if (!spsc_fifo_round_capacity(min_capacity, &capacity) || !spsc_fifo_size_add(&size, capacity)) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return spsc_fifo_alloc_syserr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return spsc_fifo_alloc_syserr;
+    }
+
+    if (st.st_size != 0 && (uint64_t)st.st_size != size) {
+        close(fd);
+        return spsc_fifo_alloc_mismatch;
+    }
+
+    if (st.st_size == 0 && ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return spsc_fifo_alloc_syserr;
+    }
+
+    struct spsc_fifo_shm_header *header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED) {
+        return spsc_fifo_alloc_syserr;
+    }
+
+    *fifo = (spsc_fifo*)((spsc_fifo_byte*)header + spsc_fifo_shm_fifo_offset());
+
+    /* A zero magic is a new file, or one whose creation never finished. */
+    if (SPSC_FIFO_ATOMIC_LOAD(&(header->magic), SPSC_FIFO_MEMORY_ORDER_RELAXED) == 0) {
+        header->version     = SPSC_FIFO_SHM_VERSION;
+        header->header_size = sizeof(spsc_fifo);
+        header->capacity    = capacity;
+        header->size        = size;
+
+        spsc_fifo_init(*fifo, header, (spsc_fifo_byte*)header + spsc_fifo_shm_buf_offset(), capacity, spsc_fifo_kind_file);
+        (*fifo)->map_len = size;
+        spsc_fifo_file_checkpoint(*fifo);
+
+        SPSC_FIFO_ATOMIC_STORE(&(header->magic), SPSC_FIFO_SHM_MAGIC, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    } else if (!spsc_fifo_shm_header_valid(header, size) || (*fifo)->kind != spsc_fifo_kind_file ||
+               !spsc_fifo_file_recover(*fifo)) {
+        munmap(header, size);
+        *fifo = NULL;
+        return spsc_fifo_alloc_mismatch;
+    }
+
+    (*fifo)->map_len       = size;
+    (*fifo)->sync_interval = sync_interval;
+    SPSC_FIFO_ATOMIC_STORE(&((*fifo)->sync_count), (*fifo)->write_shadow, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    return spsc_fifo_alloc_success;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(path);
+    SPSC_FIFO_IGNORE(min_capacity);
+    SPSC_FIFO_IGNORE(sync_interval);
+    return spsc_fifo_alloc_syserr;
+#endif
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_file_sync(spsc_fifo *fifo) {
+#ifdef SPSC_FIFO_SHM
+    if (fifo->kind != spsc_fifo_kind_file) {
+        return false;
+    }
+
+    /* loaded before writing back, so the checkpoint covers at least up to here */
     const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
-    const spsc_fifo_usize read_avail  = write_count - read_count;
+    if (!spsc_fifo_file_checkpoint(fifo)) {
+        return false;
+    }
+
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->sync_count), write_count, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    return true;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    return false;
+#endif
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_file_sync_due(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    return fifo->sync_interval != 0 &&
+           SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED) -
+           SPSC_FIFO_ATOMIC_LOAD(&(fifo->sync_count), SPSC_FIFO_MEMORY_ORDER_RELAXED) >= fifo->sync_interval;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_free(spsc_fifo **fifo) {
+    if (*fifo == NULL) {
+        return;
+    }
+
+#if defined(SPSC_FIFO_EVENTFD) && defined(SPSC_FIFO_LINUX)
+    if ((*fifo)->read_fd >= 0) {
+        close((*fifo)->read_fd);
+        close((*fifo)->write_fd);
+    }
+#endif
+
+    switch ((*fifo)->kind) {
+#ifdef SPSC_FIFO_MIRRORED_BUF
+        case spsc_fifo_kind_mirrored:
+            munmap(spsc_fifo_buf(*fifo), 2 * (size_t)(*fifo)->capacity);
+            SPSC_FIFO_FREE(spsc_fifo_mem(*fifo));
+            break;
+#endif
+#ifdef SPSC_FIFO_SHM
+        case spsc_fifo_kind_shm:
+        case spsc_fifo_kind_file:
+            spsc_fifo_shm_unmap(*fifo);
+            break;
+#endif
+#ifdef SPSC_FIFO_MAPPED_BUF
+        case spsc_fifo_kind_mapped:
+            munmap(spsc_fifo_buf(*fifo), (*fifo)->map_len);
+            SPSC_FIFO_FREE(spsc_fifo_mem(*fifo));
+            break;
+#endif
+        default:
+            SPSC_FIFO_FREE(spsc_fifo_mem(*fifo));
+            break;
+    }
+
+    *fifo = NULL;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_reset(spsc_fifo *fifo) {
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->closed), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->write_shadow      = 0;
+    fifo->read_count_cache  = 0;
+    fifo->read_shadow       = 0;
+    fifo->write_count_cache = 0;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->lossy_oldest), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->lossy_index        = 0;
+    fifo->lossy_next         = 0;
+    fifo->lossy_lost_records = 0;
+    fifo->lossy_lost_bytes   = 0;
+#ifdef SPSC_FIFO_TRACE
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_head), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->trace_tail), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->trace_countdown  = fifo->trace_rate;
+    fifo->trace_head_cache = 0;
+#endif
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_is_mirrored(spsc_fifo *fifo) {
+    return fifo->kind == spsc_fifo_kind_mirrored;
+}
+
+SPSC_FIFO_IMPL unsigned spsc_fifo_alloc_flags(spsc_fifo *fifo) {
+    return fifo->alloc_flags;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_bind_producer(spsc_fifo *fifo) {
+#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
+    fifo->producer_thrd  = thrd_current();
+    fifo->producer_bound = true;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+#endif
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_bind_consumer(spsc_fifo *fifo) {
+#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
+    fifo->consumer_thrd  = thrd_current();
+    fifo->consumer_bound = true;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+#endif
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_read_avail(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    fifo->write_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+
+    return fifo->write_count_cache - read_count;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_is_empty(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+
+    return spsc_fifo_readable(fifo, read_count, 1) == 0;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_skip(spsc_fifo *fifo, spsc_fifo_usize amount) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    const spsc_fifo_usize read_avail = spsc_fifo_readable(fifo, read_count, amount);
     if (amount > read_avail) {
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, read_avail == 0);
+        SPSC_FIFO_STATS_ADD(fifo, partial_reads, read_avail != 0);
         amount = read_avail;
     }
 
-    if (amount == 0) {
-        return 0;
+    if (amount == 0) {
+        return 0;
+    }
+
+    spsc_fifo_advance_read(fifo, read_count + amount);
+
+    return amount;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_skip_n(spsc_fifo *fifo, spsc_fifo_usize amount) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    if (amount == 0) {
+        return false;
+    }
+    if (amount > spsc_fifo_readable(fifo, read_count, amount)) {
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, 1);
+        return false;
+    }
+
+    spsc_fifo_advance_read(fifo, read_count + amount);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_read(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    const spsc_fifo_usize read_avail = spsc_fifo_readable(fifo, read_count, max);
+    if (max > read_avail) {
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, read_avail == 0);
+        SPSC_FIFO_STATS_ADD(fifo, partial_reads, read_avail != 0);
+        max = read_avail;
+    }
+
+    if (max == 0) {
+        return 0;
+    }
+
+    spsc_fifo_copy_from_buf(fifo, read_count & fifo->mask, to, max);
+
+    spsc_fifo_advance_read(fifo, read_count + max);
+
+    return max;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_read_n(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    if (len == 0) {
+        return false;
+    }
+    if (len > spsc_fifo_readable(fifo, read_count, len)) {
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, 1);
+        return false;
+    }
+
+    spsc_fifo_copy_from_buf(fifo, read_count & fifo->mask, to, len);
+
+    spsc_fifo_advance_read(fifo, read_count + len);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_peek(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    const spsc_fifo_usize read_avail = spsc_fifo_readable(fifo, read_count, max);
+    if (max > read_avail) {
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, read_avail == 0);
+        SPSC_FIFO_STATS_ADD(fifo, partial_reads, read_avail != 0);
+        max = read_avail;
+    }
+
+    if (max == 0) {
+        return 0;
+    }
+
+    spsc_fifo_copy_from_buf(fifo, read_count & fifo->mask, to, max);
+
+    return max;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_peek_n(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    if (len == 0) {
+        return false;
+    }
+    if (len > spsc_fifo_readable(fifo, read_count, len)) {
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, 1);
+        return false;
+    }
+
+    spsc_fifo_copy_from_buf(fifo, read_count & fifo->mask, to, len);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_set_read_batch(spsc_fifo *fifo, spsc_fifo_usize bytes) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    fifo->read_batch = bytes;
+    spsc_fifo_flush_pending_read(fifo);
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_flush_read(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    spsc_fifo_flush_pending_read(fifo);
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_read_acquire(spsc_fifo *fifo, spsc_fifo_region regions[2], spsc_fifo_usize max) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    const spsc_fifo_usize read_avail = spsc_fifo_readable(fifo, read_count, max);
+    if (max > read_avail) {
+        max = read_avail;
+    }
+
+    const spsc_fifo_usize read_idx = read_count & fifo->mask;
+    const spsc_fifo_usize len = spsc_fifo_min(max, fifo->span - read_idx);
+    regions[0].ptr = spsc_fifo_buf(fifo) + read_idx;
+    regions[0].len = len;
+    regions[1].ptr = spsc_fifo_buf(fifo);
+    regions[1].len = max - len;
+
+    return max;
+}
+
+SPSC_FIFO_IMPL const spsc_fifo_byte *spsc_fifo_read_acquire_contig(spsc_fifo *fifo, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    const spsc_fifo_usize read_idx   = read_count & fifo->mask;
+    if (len == 0 || len > fifo->span - read_idx || len > spsc_fifo_readable(fifo, read_count, len)) {
+        return NULL;
+    }
+
+    return spsc_fifo_buf(fifo) + read_idx;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_read_release(spsc_fifo *fifo, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    SPSC_FIFO_ASSERT(len <= fifo->write_count_cache - read_count);
+
+    if (len == 0) {
+        return;
+    }
+
+    spsc_fifo_advance_read(fifo, read_count + len);
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_write_avail(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    fifo->read_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+
+    return fifo->capacity - (write_count - fifo->read_count_cache);
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_is_full(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+
+    return spsc_fifo_writable(fifo, write_count, 1) == 0;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_write(spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    const spsc_fifo_usize write_avail = spsc_fifo_writable(fifo, write_count, len);
+    if (len > write_avail) {
+        SPSC_FIFO_STATS_ADD(fifo, write_full, write_avail == 0);
+        SPSC_FIFO_STATS_ADD(fifo, partial_writes, write_avail != 0);
+        len = write_avail;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    spsc_fifo_copy_to_buf(fifo, write_count & fifo->mask, from, len);
+
+    spsc_fifo_advance_write(fifo, write_count + len);
+
+    return len;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_write_n(spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    if (len == 0) {
+        return false;
+    }
+    if (len > spsc_fifo_writable(fifo, write_count, len)) {
+        SPSC_FIFO_STATS_ADD(fifo, write_full, 1);
+        return false;
+    }
+
+    spsc_fifo_copy_to_buf(fifo, write_count & fifo->mask, from, len);
+
+    spsc_fifo_advance_write(fifo, write_count + len);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_set_write_batch(spsc_fifo *fifo, spsc_fifo_usize bytes) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    fifo->write_batch = bytes;
+    spsc_fifo_flush_pending_write(fifo);
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_flush_write(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    spsc_fifo_flush_pending_write(fifo);
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_write_reserve(spsc_fifo *fifo, spsc_fifo_region regions[2], spsc_fifo_usize max) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    const spsc_fifo_usize write_avail = spsc_fifo_writable(fifo, write_count, max);
+    if (max > write_avail) {
+        max = write_avail;
+    }
+
+    const spsc_fifo_usize write_idx = write_count & fifo->mask;
+    const spsc_fifo_usize len = spsc_fifo_min(max, fifo->span - write_idx);
+    regions[0].ptr = spsc_fifo_buf(fifo) + write_idx;
+    regions[0].len = len;
+    regions[1].ptr = spsc_fifo_buf(fifo);
+    regions[1].len = max - len;
+
+    return max;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_byte *spsc_fifo_write_reserve_contig(spsc_fifo *fifo, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    const spsc_fifo_usize write_idx   = write_count & fifo->mask;
+    if (len == 0 || len > fifo->span - write_idx || len > spsc_fifo_writable(fifo, write_count, len)) {
+        return NULL;
+    }
+
+    return spsc_fifo_buf(fifo) + write_idx;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_write_commit(spsc_fifo *fifo, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    SPSC_FIFO_ASSERT(len <= fifo->capacity - (write_count - fifo->read_count_cache));
+
+    if (len == 0) {
+        return;
+    }
+
+    spsc_fifo_advance_write(fifo, write_count + len);
+}
+
+/* Sets closed and, with SPSC_FIFO_WAIT, wakes a parked peer. Both wake words are bumped after closed is set, and
+   a waiter loads its word before checking closed, so a peer about to park either sees closed or finds its word
+   changed and returns at once - a single wake can't be lost. */
+SPSC_FIFO_UTIL void spsc_fifo_close(spsc_fifo *fifo) {
+#ifdef SPSC_FIFO_WAIT
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->closed), true, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    SPSC_FIFO_ATOMIC_FETCH_ADD(&(fifo->consumer_wake), 1, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    SPSC_FIFO_ATOMIC_FETCH_ADD(&(fifo->producer_wake), 1, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    spsc_fifo_unpark(&(fifo->consumer_wake), fifo->kind == spsc_fifo_kind_shm);
+    spsc_fifo_unpark(&(fifo->producer_wake), fifo->kind == spsc_fifo_kind_shm);
+#else
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->closed), true, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+    spsc_fifo_event_signal(fifo->read_fd);
+    spsc_fifo_event_signal(fifo->write_fd);
+#endif
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_close_write(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    spsc_fifo_flush_pending_write(fifo);
+    spsc_fifo_close(fifo);
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_close_read(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    spsc_fifo_flush_pending_read(fifo);
+    spsc_fifo_close(fifo);
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_is_closed(spsc_fifo *fifo) {
+    return SPSC_FIFO_ATOMIC_LOAD(&(fifo->closed), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_is_eof(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    /* closed first: its acquire makes every write published before close_write visible to the check below */
+    return spsc_fifo_is_closed(fifo) && spsc_fifo_readable(fifo, fifo->read_shadow, 1) == 0;
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_group_alloc(spsc_fifo_group **group, spsc_fifo_usize max_members) {
+    if (max_members == 0) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    const size_t members = (size_t)max_members;
+    if ((spsc_fifo_usize)members != max_members || members > (SIZE_MAX / 4) / sizeof(spsc_fifo*)) {
+        return spsc_fifo_alloc_inval;
+    }
+    const size_t words = (members + SPSC_FIFO_GROUP_WORD_BITS - 1) / SPSC_FIFO_GROUP_WORD_BITS;
+
+    const size_t members_offset = (size_t)spsc_fifo_align_forward(sizeof(**group), _Alignof(spsc_fifo*));
+    const size_t ready_offset   = (size_t)spsc_fifo_align_forward(members_offset + members * sizeof(spsc_fifo*), SPSC_FIFO_CACHE_LINE_SIZE);
+    const size_t ready_size     = (size_t)spsc_fifo_align_forward(words * sizeof(unsigned long), SPSC_FIFO_CACHE_LINE_SIZE);
+
+    void *mem = SPSC_FIFO_ALLOC(_Alignof(spsc_fifo_group) - 1 + ready_offset + ready_size);
+    if (mem == NULL) {
+        return spsc_fifo_alloc_nomem;
+    }
+
+    *group = (spsc_fifo_group*)spsc_fifo_align_forward((spsc_fifo_uptr)mem, _Alignof(spsc_fifo_group));
+    (*group)->members     = (spsc_fifo**)((spsc_fifo_byte*)(*group) + members_offset);
+    (*group)->ready       = (void*)((spsc_fifo_byte*)(*group) + ready_offset);
+    (*group)->mem         = mem;
+    (*group)->max_members = max_members;
+    (*group)->count       = 0;
+    (*group)->cursor      = 0;
+    for (size_t i = 0; i < words; ++i) {
+        SPSC_FIFO_ATOMIC_STORE(&((*group)->ready[i]), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    }
+#ifdef SPSC_FIFO_WAIT
+    SPSC_FIFO_ATOMIC_STORE(&((*group)->epoch), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&((*group)->waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#endif
+
+    return spsc_fifo_alloc_success;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_group_free(spsc_fifo_group **group) {
+    if (*group == NULL) {
+        return;
+    }
+
+    for (spsc_fifo_usize i = 0; i < (*group)->count; ++i) {
+        (*group)->members[i]->group = NULL;
+    }
+
+    SPSC_FIFO_FREE((*group)->mem);
+    *group = NULL;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_group_add(spsc_fifo_group *group, spsc_fifo *fifo) {
+    if (group->count == group->max_members || fifo->group != NULL || fifo->kind == spsc_fifo_kind_shm) {
+        return false;
+    }
+
+    const spsc_fifo_usize index = group->count++;
+    group->members[index] = fifo;
+    fifo->group_index = index;
+    fifo->group       = group;
+
+    /* Start out ready, the first poll finds out whether the FIFO already holds data. */
+    SPSC_FIFO_ATOMIC_FETCH_OR(&(group->ready[index / SPSC_FIFO_GROUP_WORD_BITS]),
+                              1UL << (index % SPSC_FIFO_GROUP_WORD_BITS), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+
+    return true;
+}
+
+SPSC_FIFO_UTIL unsigned spsc_fifo_group_ctz(unsigned long bits) {
+#ifdef __GNUC__
+    return (unsigned)__builtin_ctzl(bits);
+#else
+    unsigned n = 0;
+    while ((bits & 1UL) == 0) {
+        bits >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+/* Consumer side: true if a member marked ready holds data. An empty member has its bit cleared, then is checked
+   once more after a fence, in case its producer published just before seeing the bit still set. */
+SPSC_FIFO_UTIL bool spsc_fifo_group_poll(spsc_fifo_group *group, spsc_fifo *fifo, SPSC_FIFO_ATOMIC(unsigned long) *word, unsigned long bit) {
+    if (spsc_fifo_readable(fifo, fifo->read_shadow, 1) != 0) {
+        return true;
+    }
+
+    SPSC_FIFO_ATOMIC_FETCH_AND(word, ~bit, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    SPSC_FIFO_ATOMIC_THREAD_FENCE(SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+
+    if (spsc_fifo_readable(fifo, fifo->read_shadow, 1) != 0) {
+        SPSC_FIFO_ATOMIC_FETCH_OR(word, bit, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        return true;
+    }
+
+    SPSC_FIFO_IGNORE(group);
+    return false;
+}
+
+SPSC_FIFO_IMPL spsc_fifo *spsc_fifo_group_next_ready(spsc_fifo_group *group) {
+    const spsc_fifo_usize words = (group->count + SPSC_FIFO_GROUP_WORD_BITS - 1) / SPSC_FIFO_GROUP_WORD_BITS;
+    const spsc_fifo_usize start = group->cursor;
+    const unsigned long   from  = ~0UL << (start % SPSC_FIFO_GROUP_WORD_BITS);
+
+    /* Words from the cursor onwards, wrapping around to the bits of the cursor's word below it last. */
+    for (spsc_fifo_usize n = 0; n <= words && words != 0; ++n) {
+        const spsc_fifo_usize w = (start / SPSC_FIFO_GROUP_WORD_BITS + n) % words;
+        SPSC_FIFO_ATOMIC(unsigned long) *word = &(group->ready[w]);
+
+        unsigned long bits = SPSC_FIFO_ATOMIC_LOAD(word, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        if (n == 0) {
+            bits &= from;
+        } else if (n == words) {
+            bits &= ~from;
+        }
+
+        while (bits != 0) {
+            const unsigned long bit = bits & (~bits + 1);
+            const spsc_fifo_usize index = w * SPSC_FIFO_GROUP_WORD_BITS + spsc_fifo_group_ctz(bits);
+            bits &= bits - 1;
+
+            spsc_fifo *fifo = group->members[index];
+            if (spsc_fifo_group_poll(group, fifo, word, bit)) {
+                group->cursor = (index + 1) % group->count;
+                return fifo;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_bcast_alloc(spsc_fifo_bcast **bcast, spsc_fifo_usize min_capacity, unsigned consumers) {
+    const size_t readers = consumers;
+    if (readers == 0 || readers > (SIZE_MAX / 4) / sizeof(struct spsc_fifo_bcast_reader)) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    const size_t readers_offset = (size_t)spsc_fifo_align_forward(sizeof(**bcast), _Alignof(struct spsc_fifo_bcast_reader));
+    void *mem = SPSC_FIFO_ALLOC(_Alignof(struct spsc_fifo_bcast_reader) - 1 + readers_offset + readers * sizeof(struct spsc_fifo_bcast_reader));
+    if (mem == NULL) {
+        return spsc_fifo_alloc_nomem;
+    }
+
+    *bcast = (spsc_fifo_bcast*)spsc_fifo_align_forward((spsc_fifo_uptr)mem, _Alignof(struct spsc_fifo_bcast_reader));
+    const int status = spsc_fifo_alloc(&((*bcast)->ring), min_capacity);
+    if (status != spsc_fifo_alloc_success) {
+        SPSC_FIFO_FREE(mem);
+        *bcast = NULL;
+        return status;
+    }
+
+    (*bcast)->readers   = (struct spsc_fifo_bcast_reader*)((spsc_fifo_byte*)(*bcast) + readers_offset);
+    (*bcast)->mem       = mem;
+    (*bcast)->consumers = consumers;
+#ifdef SPSC_FIFO_TRACE
+    /* Stamps are drained by the ring's own consumer, which a broadcast FIFO doesn't have. */
+    (*bcast)->ring->trace_rate = 0;
+#endif
+    for (unsigned i = 0; i < consumers; ++i) {
+        SPSC_FIFO_ATOMIC_STORE(&((*bcast)->readers[i].read_count), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        (*bcast)->readers[i].write_count_cache = 0;
+#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
+        (*bcast)->readers[i].consumer_bound = false;
+#endif
+    }
+
+    return spsc_fifo_alloc_success;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_bcast_free(spsc_fifo_bcast **bcast) {
+    if (*bcast == NULL) {
+        return;
+    }
+
+    spsc_fifo_free(&((*bcast)->ring));
+    SPSC_FIFO_FREE((*bcast)->mem);
+    *bcast = NULL;
+}
+
+/* Producer side: like spsc_fifo_writable, but the position to reload is the minimum over all consumers. The
+   cached minimum only moves forward, so the cursors are scanned only when it says the ring is too full. */
+SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_bcast_writable(spsc_fifo_bcast *bcast, spsc_fifo_usize write_count, spsc_fifo_usize want) {
+    spsc_fifo *ring = bcast->ring;
+    spsc_fifo_usize write_avail = ring->capacity - (write_count - ring->read_count_cache);
+    if (write_avail < want) {
+        spsc_fifo_usize lag = 0;
+        for (unsigned i = 0; i < bcast->consumers; ++i) {
+            lag = spsc_fifo_max(lag, write_count - SPSC_FIFO_ATOMIC_LOAD(&(bcast->readers[i].read_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE));
+        }
+        ring->read_count_cache = write_count - lag;
+        write_avail = ring->capacity - lag;
+        if (write_avail < want) {
+            spsc_fifo_flush_pending_write(ring);
+        }
+    }
+    return write_avail;
+}
+
+/* Consumer side: spsc_fifo_readable against one cursor. */
+SPSC_FIFO_UTIL spsc_fifo_usize spsc_fifo_bcast_readable(spsc_fifo_bcast *bcast, struct spsc_fifo_bcast_reader *reader, spsc_fifo_usize read_count, spsc_fifo_usize want) {
+    spsc_fifo_usize read_avail = reader->write_count_cache - read_count;
+    if (read_avail < want) {
+        reader->write_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(bcast->ring->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+        read_avail = reader->write_count_cache - read_count;
+    }
+    return read_avail;
+}
+
+/* Copies out without touching the ring's statistics, which belong to a single consumer. */
+SPSC_FIFO_UTIL void spsc_fifo_bcast_copy_from_buf(spsc_fifo_bcast *bcast, spsc_fifo_usize idx, spsc_fifo_byte *to, spsc_fifo_usize len) {
+    const spsc_fifo_usize l = spsc_fifo_min(len, bcast->ring->span - idx);
+    memcpy(to, spsc_fifo_buf(bcast->ring) + idx, l);
+    if (l < len) {
+        memcpy(to + l, spsc_fifo_buf(bcast->ring), len - l);
+    }
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_bcast_write_avail(spsc_fifo_bcast *bcast) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(bcast->ring);
+
+    return spsc_fifo_bcast_writable(bcast, bcast->ring->write_shadow, bcast->ring->capacity);
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_bcast_write(spsc_fifo_bcast *bcast, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(bcast->ring);
+
+    spsc_fifo *ring = bcast->ring;
+    const spsc_fifo_usize write_count = ring->write_shadow;
+    const spsc_fifo_usize write_avail = spsc_fifo_bcast_writable(bcast, write_count, len);
+    if (len > write_avail) {
+        SPSC_FIFO_STATS_ADD(ring, write_full, write_avail == 0);
+        SPSC_FIFO_STATS_ADD(ring, partial_writes, write_avail != 0);
+        len = write_avail;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    spsc_fifo_copy_to_buf(ring, write_count & ring->mask, from, len);
+
+    spsc_fifo_advance_write(ring, write_count + len);
+
+    return len;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_bcast_write_n(spsc_fifo_bcast *bcast, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(bcast->ring);
+
+    spsc_fifo *ring = bcast->ring;
+    const spsc_fifo_usize write_count = ring->write_shadow;
+    if (len == 0) {
+        return false;
+    }
+    if (len > spsc_fifo_bcast_writable(bcast, write_count, len)) {
+        SPSC_FIFO_STATS_ADD(ring, write_full, 1);
+        return false;
+    }
+
+    spsc_fifo_copy_to_buf(ring, write_count & ring->mask, from, len);
+
+    spsc_fifo_advance_write(ring, write_count + len);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_bcast_read_avail(spsc_fifo_bcast *bcast, unsigned consumer) {
+    SPSC_FIFO_ASSERT(consumer < bcast->consumers);
+    struct spsc_fifo_bcast_reader *reader = &(bcast->readers[consumer]);
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(reader);
+
+    const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(reader->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    reader->write_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(bcast->ring->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+
+    return reader->write_count_cache - read_count;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_bcast_skip(spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_usize amount) {
+    SPSC_FIFO_ASSERT(consumer < bcast->consumers);
+    struct spsc_fifo_bcast_reader *reader = &(bcast->readers[consumer]);
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(reader);
+
+    const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(reader->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    amount = spsc_fifo_min(amount, spsc_fifo_bcast_readable(bcast, reader, read_count, amount));
+
+    if (amount == 0) {
+        return 0;
+    }
+
+    SPSC_FIFO_ATOMIC_STORE(&(reader->read_count), read_count + amount, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+
+    return amount;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_bcast_skip_n(spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_usize amount) {
+    SPSC_FIFO_ASSERT(consumer < bcast->consumers);
+    struct spsc_fifo_bcast_reader *reader = &(bcast->readers[consumer]);
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(reader);
+
+    const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(reader->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (amount == 0 || amount > spsc_fifo_bcast_readable(bcast, reader, read_count, amount)) {
+        return false;
+    }
+
+    SPSC_FIFO_ATOMIC_STORE(&(reader->read_count), read_count + amount, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_bcast_read(spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_byte *to, spsc_fifo_usize max) {
+    SPSC_FIFO_ASSERT(consumer < bcast->consumers);
+    struct spsc_fifo_bcast_reader *reader = &(bcast->readers[consumer]);
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(reader);
+
+    const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(reader->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    max = spsc_fifo_min(max, spsc_fifo_bcast_readable(bcast, reader, read_count, max));
+
+    if (max == 0) {
+        return 0;
+    }
+
+    spsc_fifo_bcast_copy_from_buf(bcast, read_count & bcast->ring->mask, to, max);
+
+    SPSC_FIFO_ATOMIC_STORE(&(reader->read_count), read_count + max, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+
+    return max;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_bcast_read_n(spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_byte *to, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT(consumer < bcast->consumers);
+    struct spsc_fifo_bcast_reader *reader = &(bcast->readers[consumer]);
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(reader);
+
+    const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(reader->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (len == 0 || len > spsc_fifo_bcast_readable(bcast, reader, read_count, len)) {
+        return false;
+    }
+
+    spsc_fifo_bcast_copy_from_buf(bcast, read_count & bcast->ring->mask, to, len);
+
+    SPSC_FIFO_ATOMIC_STORE(&(reader->read_count), read_count + len, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_bcast_peek(spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_byte *to, spsc_fifo_usize max) {
+    SPSC_FIFO_ASSERT(consumer < bcast->consumers);
+    struct spsc_fifo_bcast_reader *reader = &(bcast->readers[consumer]);
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(reader);
+
+    const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(reader->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    max = spsc_fifo_min(max, spsc_fifo_bcast_readable(bcast, reader, read_count, max));
+
+    if (max == 0) {
+        return 0;
+    }
+
+    spsc_fifo_bcast_copy_from_buf(bcast, read_count & bcast->ring->mask, to, max);
+
+    return max;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_bcast_peek_n(spsc_fifo_bcast *bcast, unsigned consumer, spsc_fifo_byte *to, spsc_fifo_usize len) {
+    SPSC_FIFO_ASSERT(consumer < bcast->consumers);
+    struct spsc_fifo_bcast_reader *reader = &(bcast->readers[consumer]);
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(reader);
+
+    const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(reader->read_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (len == 0 || len > spsc_fifo_bcast_readable(bcast, reader, read_count, len)) {
+        return false;
+    }
+
+    spsc_fifo_bcast_copy_from_buf(bcast, read_count & bcast->ring->mask, to, len);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_bcast_bind_producer(spsc_fifo_bcast *bcast) {
+    spsc_fifo_bind_producer(bcast->ring);
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_bcast_bind_consumer(spsc_fifo_bcast *bcast, unsigned consumer) {
+    SPSC_FIFO_ASSERT(consumer < bcast->consumers);
+#ifdef SPSC_FIFO_THREAD_SAFETY_DEBUG
+    bcast->readers[consumer].consumer_thrd  = thrd_current();
+    bcast->readers[consumer].consumer_bound = true;
+#else
+    SPSC_FIFO_IGNORE(bcast);
+    SPSC_FIFO_IGNORE(consumer);
+#endif
+}
+
+SPSC_FIFO_UTIL struct spsc_fifo_seg_node *spsc_fifo_seg_node_alloc(spsc_fifo_seg *seg) {
+    struct spsc_fifo_seg_node *node = (struct spsc_fifo_seg_node*)SPSC_FIFO_ALLOC(sizeof(*node));
+    if (node == NULL) {
+        return NULL;
+    }
+
+    if (spsc_fifo_alloc(&(node->ring), seg->segment_capacity) != spsc_fifo_alloc_success) {
+        SPSC_FIFO_FREE(node);
+        return NULL;
+    }
+    SPSC_FIFO_ATOMIC_STORE(&(node->next), NULL, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_FETCH_ADD(&(seg->memory), node->ring->capacity, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    return node;
+}
+
+SPSC_FIFO_UTIL void spsc_fifo_seg_node_free(spsc_fifo_seg *seg, struct spsc_fifo_seg_node *node) {
+    SPSC_FIFO_ATOMIC_FETCH_ADD(&(seg->memory), (spsc_fifo_usize)0 - node->ring->capacity, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    spsc_fifo_free(&(node->ring));
+    SPSC_FIFO_FREE(node);
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_seg_alloc(spsc_fifo_seg **seg, spsc_fifo_usize segment_capacity, spsc_fifo_usize soft_cap, spsc_fifo_usize hard_cap) {
+    spsc_fifo_usize capacity;
+    if (!spsc_fifo_round_capacity(segment_capacity, &capacity) || (hard_cap != 0 && hard_cap < capacity)) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    void *mem = SPSC_FIFO_ALLOC(_Alignof(spsc_fifo_seg) - 1 + sizeof(**seg));
+    if (mem == NULL) {
+        return spsc_fifo_alloc_nomem;
+    }
+
+    *seg = (spsc_fifo_seg*)spsc_fifo_align_forward((spsc_fifo_uptr)mem, _Alignof(spsc_fifo_seg));
+    (*seg)->segment_capacity = capacity;
+    (*seg)->soft_cap         = soft_cap;
+    (*seg)->hard_cap         = hard_cap;
+    (*seg)->mem              = mem;
+    (*seg)->spare            = NULL;
+    SPSC_FIFO_ATOMIC_STORE(&((*seg)->cache_head), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&((*seg)->cache_tail), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&((*seg)->memory), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    struct spsc_fifo_seg_node *node = spsc_fifo_seg_node_alloc(*seg);
+    if (node == NULL) {
+        SPSC_FIFO_FREE(mem);
+        *seg = NULL;
+        return spsc_fifo_alloc_nomem;
+    }
+    (*seg)->head = node;
+    (*seg)->tail = node;
+
+    return spsc_fifo_alloc_success;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_seg_free(spsc_fifo_seg **seg) {
+    if (*seg == NULL) {
+        return;
+    }
+
+    for (struct spsc_fifo_seg_node *node = (*seg)->head; node != NULL;) {
+        struct spsc_fifo_seg_node *next = SPSC_FIFO_ATOMIC_LOAD(&(node->next), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        spsc_fifo_seg_node_free(*seg, node);
+        node = next;
+    }
+    for (struct spsc_fifo_seg_node *node = (*seg)->spare; node != NULL;) {
+        struct spsc_fifo_seg_node *next = SPSC_FIFO_ATOMIC_LOAD(&(node->next), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        spsc_fifo_seg_node_free(*seg, node);
+        node = next;
+    }
+    const spsc_fifo_usize cache_tail = SPSC_FIFO_ATOMIC_LOAD(&((*seg)->cache_tail), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    for (spsc_fifo_usize i = SPSC_FIFO_ATOMIC_LOAD(&((*seg)->cache_head), SPSC_FIFO_MEMORY_ORDER_RELAXED); i != cache_tail; ++i) {
+        spsc_fifo_seg_node_free(*seg, (*seg)->cache[i % SPSC_FIFO_SEG_CACHE]);
+    }
+
+    SPSC_FIFO_FREE((*seg)->mem);
+    *seg = NULL;
+}
+
+/* Producer side: an empty segment from the spare list, the consumer's cache, or a new allocation within hard_cap. */
+SPSC_FIFO_UTIL struct spsc_fifo_seg_node *spsc_fifo_seg_take(spsc_fifo_seg *seg) {
+    struct spsc_fifo_seg_node *node = seg->spare;
+    if (node != NULL) {
+        seg->spare = SPSC_FIFO_ATOMIC_LOAD(&(node->next), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_STORE(&(node->next), NULL, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        return node;
+    }
+
+    const spsc_fifo_usize cache_head = SPSC_FIFO_ATOMIC_LOAD(&(seg->cache_head), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (cache_head != SPSC_FIFO_ATOMIC_LOAD(&(seg->cache_tail), SPSC_FIFO_MEMORY_ORDER_ACQUIRE)) {
+        node = seg->cache[cache_head % SPSC_FIFO_SEG_CACHE];
+        SPSC_FIFO_ATOMIC_STORE(&(seg->cache_head), cache_head + 1, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+        return node;
+    }
+
+    if (seg->hard_cap != 0 &&
+        SPSC_FIFO_ATOMIC_LOAD(&(seg->memory), SPSC_FIFO_MEMORY_ORDER_RELAXED) > seg->hard_cap - seg->segment_capacity) {
+        return NULL;
+    }
+
+    return spsc_fifo_seg_node_alloc(seg);
+}
+
+/* Producer side: hands the new segments first..last to the consumer. Whatever the old tail still has batched is
+   published first, the producer never touches it again. */
+SPSC_FIFO_UTIL void spsc_fifo_seg_link(spsc_fifo_seg *seg, struct spsc_fifo_seg_node *first, struct spsc_fifo_seg_node *last) {
+    spsc_fifo_flush_write(seg->tail->ring);
+    SPSC_FIFO_ATOMIC_STORE(&(seg->tail->next), first, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    seg->tail = last;
+}
+
+/* Consumer side: the drained head is recycled while memory is within soft_cap and the cache has room. */
+SPSC_FIFO_UTIL void spsc_fifo_seg_retire(spsc_fifo_seg *seg, struct spsc_fifo_seg_node *node) {
+    const spsc_fifo_usize cache_tail = SPSC_FIFO_ATOMIC_LOAD(&(seg->cache_tail), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    const bool keep = (seg->soft_cap == 0 || SPSC_FIFO_ATOMIC_LOAD(&(seg->memory), SPSC_FIFO_MEMORY_ORDER_RELAXED) <= seg->soft_cap) &&
+                      cache_tail - SPSC_FIFO_ATOMIC_LOAD(&(seg->cache_head), SPSC_FIFO_MEMORY_ORDER_ACQUIRE) < SPSC_FIFO_SEG_CACHE;
+    if (!keep) {
+        spsc_fifo_seg_node_free(seg, node);
+        return;
+    }
+
+    spsc_fifo_reset(node->ring);
+    SPSC_FIFO_ATOMIC_STORE(&(node->next), NULL, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    seg->cache[cache_tail % SPSC_FIFO_SEG_CACHE] = node;
+    SPSC_FIFO_ATOMIC_STORE(&(seg->cache_tail), cache_tail + 1, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_seg_write(spsc_fifo_seg *seg, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+    spsc_fifo_usize written = spsc_fifo_write(seg->tail->ring, from, len);
+    while (written < len) {
+        /* The consumer may have drained the tail since, and growing then would only waste a segment. */
+        spsc_fifo *tail = seg->tail->ring;
+        if (spsc_fifo_writable(tail, tail->write_shadow, len - written) != 0) {
+            written += spsc_fifo_write(tail, from + written, len - written);
+            continue;
+        }
+
+        struct spsc_fifo_seg_node *node = spsc_fifo_seg_take(seg);
+        if (node == NULL) {
+            break;
+        }
+
+        spsc_fifo_seg_link(seg, node, node);
+        written += spsc_fifo_write(node->ring, from + written, len - written);
+    }
+
+    return written;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_seg_write_n(spsc_fifo_seg *seg, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+    if (spsc_fifo_write_n(seg->tail->ring, from, len)) {
+        return true;
+    }
+    if (len == 0) {
+        return false;
+    }
+
+    /* Take every segment needed before writing anything, so a failure leaves the FIFO as it was. */
+    const spsc_fifo_usize tail_avail = spsc_fifo_write_avail(seg->tail->ring);
+    struct spsc_fifo_seg_node *first = NULL;
+    struct spsc_fifo_seg_node *last  = NULL;
+    for (spsc_fifo_usize taken = tail_avail; taken < len; taken += seg->segment_capacity) {
+        struct spsc_fifo_seg_node *node = spsc_fifo_seg_take(seg);
+        if (node == NULL) {
+            if (last != NULL) {
+                SPSC_FIFO_ATOMIC_STORE(&(last->next), seg->spare, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+                seg->spare = first;
+            }
+            return false;
+        }
+
+        if (last != NULL) {
+            SPSC_FIFO_ATOMIC_STORE(&(last->next), node, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        } else {
+            first = node;
+        }
+        last = node;
+    }
+
+    spsc_fifo_usize written = spsc_fifo_write(seg->tail->ring, from, tail_avail);
+    for (struct spsc_fifo_seg_node *node = first; node != last; node = SPSC_FIFO_ATOMIC_LOAD(&(node->next), SPSC_FIFO_MEMORY_ORDER_RELAXED)) {
+        written += spsc_fifo_write(node->ring, from + written, len - written);
+        spsc_fifo_flush_write(node->ring);
+    }
+    spsc_fifo_write(last->ring, from + written, len - written);
+
+    spsc_fifo_seg_link(seg, first, last);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_seg_read_avail(spsc_fifo_seg *seg) {
+    spsc_fifo_usize read_avail = 0;
+    for (struct spsc_fifo_seg_node *node = seg->head; node != NULL; node = SPSC_FIFO_ATOMIC_LOAD(&(node->next), SPSC_FIFO_MEMORY_ORDER_ACQUIRE)) {
+        read_avail += spsc_fifo_read_avail(node->ring);
+    }
+
+    return read_avail;
+}
+
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_seg_read(spsc_fifo_seg *seg, spsc_fifo_byte *to, spsc_fifo_usize max) {
+    spsc_fifo_usize read = spsc_fifo_read(seg->head->ring, to, max);
+    while (read < max) {
+        struct spsc_fifo_seg_node *next = SPSC_FIFO_ATOMIC_LOAD(&(seg->head->next), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+        if (next == NULL) {
+            break;
+        }
+
+        /* The producer is done with head, what it wrote before linking is visible now. */
+        read += spsc_fifo_read(seg->head->ring, to + read, max - read);
+        if (read == max) {
+            break;
+        }
+
+        spsc_fifo_seg_retire(seg, seg->head);
+        seg->head = next;
+        read += spsc_fifo_read(next->ring, to + read, max - read);
+    }
+
+    return read;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_seg_read_n(spsc_fifo_seg *seg, spsc_fifo_byte *to, spsc_fifo_usize len) {
+    if (spsc_fifo_read_n(seg->head->ring, to, len)) {
+        return true;
+    }
+    if (len == 0 || len > spsc_fifo_seg_read_avail(seg)) {
+        return false;
     }
 
-    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count + amount, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    spsc_fifo_seg_read(seg, to, len);
 
-    return amount;
+    return true;
 }
 
-SPSC_FIFO_IMPL bool spsc_fifo_skip_n(spsc_fifo *fifo, spsc_fifo_usize amount) {
-    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_seg_memory(spsc_fifo_seg *seg) {
+    return SPSC_FIFO_ATOMIC_LOAD(&(seg->memory), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+}
 
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
-    const spsc_fifo_usize read_avail  = write_count - read_count;
-    if (amount == 0 || amount > read_avail) {
-        return false;
+#ifdef SPSC_FIFO_POSIX
+/* Describes len bytes starting at ring index idx as up to two iovecs, returns how many are used. */
+SPSC_FIFO_UTIL int spsc_fifo_fill_iov(spsc_fifo *fifo, struct iovec iov[2], spsc_fifo_usize idx, spsc_fifo_usize len) {
+    const spsc_fifo_usize l = spsc_fifo_min(len, fifo->span - idx);
+    iov[0].iov_base = spsc_fifo_buf(fifo) + idx;
+    iov[0].iov_len  = (size_t)l;
+    iov[1].iov_base = spsc_fifo_buf(fifo);
+    iov[1].iov_len  = (size_t)(len - l);
+    return l < len ? 2 : 1;
+}
+
+SPSC_FIFO_UTIL int spsc_fifo_io_status_of(ssize_t n) {
+    if (n == 0) {
+        return spsc_fifo_io_eof;
     }
+    return errno == EAGAIN || errno == EWOULDBLOCK ? spsc_fifo_io_again : spsc_fifo_io_error;
+}
+#endif
+
+SPSC_FIFO_IMPL int spsc_fifo_write_from_fd(spsc_fifo *fifo, int fd, spsc_fifo_usize max, spsc_fifo_usize *transferred) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
 
-    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count + amount, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    *transferred = 0;
 
-    return true;
+#ifdef SPSC_FIFO_POSIX
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    const spsc_fifo_usize write_avail = spsc_fifo_writable(fifo, write_count, max);
+    if (max > write_avail) {
+        max = write_avail;
+    }
+#ifdef SPSC_FIFO_64BIT
+    if (max > SSIZE_MAX) {
+        max = SSIZE_MAX;
+    }
+#endif
+
+    if (max == 0) {
+        return spsc_fifo_io_success;
+    }
+
+    struct iovec iov[2];
+    const int iovcnt = spsc_fifo_fill_iov(fifo, iov, write_count & fifo->mask, max);
+
+    ssize_t n;
+    do {
+        n = readv(fd, iov, iovcnt);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        return spsc_fifo_io_status_of(n);
+    }
+
+    spsc_fifo_advance_write(fifo, write_count + (spsc_fifo_usize)n);
+    *transferred = (spsc_fifo_usize)n;
+
+    return spsc_fifo_io_success;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(fd);
+    SPSC_FIFO_IGNORE(max);
+    return spsc_fifo_io_error;
+#endif
 }
 
-SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_read(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max) {
+SPSC_FIFO_IMPL int spsc_fifo_read_to_fd(spsc_fifo *fifo, int fd, spsc_fifo_usize max, spsc_fifo_usize *transferred) {
     SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
 
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    *transferred = 0;
 
-    const spsc_fifo_usize read_avail = write_count - read_count;
+#ifdef SPSC_FIFO_POSIX
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    const spsc_fifo_usize read_avail = spsc_fifo_readable(fifo, read_count, max);
     if (max > read_avail) {
         max = read_avail;
     }
+#ifdef SPSC_FIFO_64BIT
+    if (max > SSIZE_MAX) {
+        max = SSIZE_MAX;
+    }
+#endif
 
     if (max == 0) {
-        return 0;
+        return spsc_fifo_io_success;
     }
 
-    const spsc_fifo_usize read_idx = read_count & fifo->mask;
-    const spsc_fifo_usize len = spsc_fifo_min(max, fifo->capacity - read_idx);
-    memcpy(to, fifo->buf + read_idx, len);
-    if (len < max) {
-        memcpy(to + len, fifo->buf, max - len);
+    struct iovec iov[2];
+    const int iovcnt = spsc_fifo_fill_iov(fifo, iov, read_count & fifo->mask, max);
+
+    ssize_t n;
+    do {
+        n = writev(fd, iov, iovcnt);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        return spsc_fifo_io_status_of(n);
+    }
+    if (n == 0) {
+        return spsc_fifo_io_success;
     }
 
-    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count + max, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    spsc_fifo_advance_read(fifo, read_count + (spsc_fifo_usize)n);
+    *transferred = (spsc_fifo_usize)n;
 
-    return max;
+    return spsc_fifo_io_success;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(fd);
+    SPSC_FIFO_IGNORE(max);
+    return spsc_fifo_io_error;
+#endif
 }
 
-SPSC_FIFO_IMPL bool spsc_fifo_read_n(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize len) {
-    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+#ifdef SPSC_FIFO_POSIX
+/* Total length of iovcnt segments, false if iovcnt is negative or the total exceeds capacity. */
+SPSC_FIFO_UTIL bool spsc_fifo_iov_len(spsc_fifo *fifo, const struct iovec *iov, int iovcnt, spsc_fifo_usize *len) {
+    if (iovcnt < 0) {
+        return false;
+    }
 
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len > (size_t)fifo->capacity - total) {
+            return false;
+        }
+        total += iov[i].iov_len;
+    }
+
+    *len = (spsc_fifo_usize)total;
+    return true;
+}
+
+/* Consumer side: scatters len bytes starting at read_count over the segments in order. */
+SPSC_FIFO_UTIL void spsc_fifo_scatter(spsc_fifo *fifo, spsc_fifo_usize read_count, const struct iovec *iov, spsc_fifo_usize len) {
+    for (int i = 0; len != 0; ++i) {
+        const spsc_fifo_usize l = spsc_fifo_min((spsc_fifo_usize)iov[i].iov_len, len);
+        spsc_fifo_copy_from_buf(fifo, read_count & fifo->mask, (spsc_fifo_byte*)iov[i].iov_base, l);
+        read_count += l;
+        len -= l;
+    }
+}
+#endif
+
+SPSC_FIFO_IMPL bool spsc_fifo_writev_n(spsc_fifo *fifo, const struct iovec *iov, int iovcnt) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
 
-    const spsc_fifo_usize read_avail = write_count - read_count;
-    if (len == 0 || len > read_avail) {
+#ifdef SPSC_FIFO_POSIX
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    spsc_fifo_usize len;
+    if (!spsc_fifo_iov_len(fifo, iov, iovcnt, &len) || len == 0) {
+        return false;
+    }
+    if (len > spsc_fifo_writable(fifo, write_count, len)) {
+        SPSC_FIFO_STATS_ADD(fifo, write_full, 1);
         return false;
     }
 
-    const spsc_fifo_usize read_idx = read_count & fifo->mask;
-    const spsc_fifo_usize l = spsc_fifo_min(len, fifo->capacity - read_idx);
-    memcpy(to, fifo->buf + read_idx, l);
-    if (l < len) {
-        memcpy(to + l, fifo->buf, len - l);
+    spsc_fifo_usize offset = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        spsc_fifo_copy_to_buf(fifo, (write_count + offset) & fifo->mask, (const spsc_fifo_byte*)iov[i].iov_base, (spsc_fifo_usize)iov[i].iov_len);
+        offset += (spsc_fifo_usize)iov[i].iov_len;
     }
 
-    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), read_count + len, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    spsc_fifo_advance_write(fifo, write_count + len);
 
     return true;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(iov);
+    SPSC_FIFO_IGNORE(iovcnt);
+    return false;
+#endif
 }
 
-SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_peek(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max) {
+SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_readv(spsc_fifo *fifo, const struct iovec *iov, int iovcnt) {
     SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
 
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#ifdef SPSC_FIFO_POSIX
+    if (iovcnt < 0) {
+        return 0;
+    }
 
-    const spsc_fifo_usize read_avail = write_count - read_count;
+    /* Segments beyond capacity can never be filled, so the total is capped instead of rejected. */
+    spsc_fifo_usize max = 0;
+    for (int i = 0; i < iovcnt && max < fifo->capacity; ++i) {
+        const size_t room = (size_t)(fifo->capacity - max);
+        max += (spsc_fifo_usize)(iov[i].iov_len < room ? iov[i].iov_len : room);
+    }
+
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    const spsc_fifo_usize read_avail = spsc_fifo_readable(fifo, read_count, max);
     if (max > read_avail) {
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, read_avail == 0);
+        SPSC_FIFO_STATS_ADD(fifo, partial_reads, read_avail != 0);
         max = read_avail;
     }
 
@@ -407,99 +3462,505 @@ SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_peek(spsc_fifo *fifo, spsc_fifo_byte *t
         return 0;
     }
 
-    const spsc_fifo_usize read_idx = read_count & fifo->mask;
-    const spsc_fifo_usize len = spsc_fifo_min(max, fifo->capacity - read_idx);
-    memcpy(to, fifo->buf + read_idx, len);
-    if (len < max) {
-        memcpy(to + len, fifo->buf, max - len);
-    }
+    spsc_fifo_scatter(fifo, read_count, iov, max);
+
+    spsc_fifo_advance_read(fifo, read_count + max);
 
     return max;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(iov);
+    SPSC_FIFO_IGNORE(iovcnt);
+    return 0;
+#endif
 }
 
-SPSC_FIFO_IMPL bool spsc_fifo_peek_n(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize len) {
+SPSC_FIFO_IMPL bool spsc_fifo_readv_n(spsc_fifo *fifo, const struct iovec *iov, int iovcnt) {
     SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
 
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
+#ifdef SPSC_FIFO_POSIX
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    spsc_fifo_usize len;
+    if (!spsc_fifo_iov_len(fifo, iov, iovcnt, &len) || len == 0) {
+        return false;
+    }
+    if (len > spsc_fifo_readable(fifo, read_count, len)) {
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, 1);
+        return false;
+    }
+
+    spsc_fifo_scatter(fifo, read_count, iov, len);
+
+    spsc_fifo_advance_read(fifo, read_count + len);
+
+    return true;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    SPSC_FIFO_IGNORE(iov);
+    SPSC_FIFO_IGNORE(iovcnt);
+    return false;
+#endif
+}
+
+#ifdef SPSC_FIFO_WAIT
+SPSC_FIFO_IMPL bool spsc_fifo_wait_readable(spsc_fifo *fifo, spsc_fifo_usize amount, const struct timespec *deadline) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
 
-    const spsc_fifo_usize read_avail = write_count - read_count;
-    if (len == 0 || len > read_avail) {
+    if (amount > fifo->capacity) {
         return false;
     }
 
-    const spsc_fifo_usize read_idx = read_count & fifo->mask;
-    const spsc_fifo_usize l = spsc_fifo_min(len, fifo->capacity - read_idx);
-    memcpy(to, fifo->buf + read_idx, l);
-    if (l < len) {
-        memcpy(to + l, fifo->buf, len - l);
+    const spsc_fifo_usize read_count = fifo->read_shadow;
+    for (unsigned spin = 0; spin < SPSC_FIFO_SPIN_COUNT; ++spin) {
+        if (spsc_fifo_readable(fifo, read_count, amount) >= amount) {
+            return true;
+        }
+        SPSC_FIFO_CPU_RELAX();
     }
 
-    return true;
+    while (true) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_waiting), true, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+        const spsc_fifo_usize wake        = SPSC_FIFO_ATOMIC_LOAD(&(fifo->consumer_wake), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+        const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+        fifo->write_count_cache = write_count;
+        if (write_count - read_count >= amount) {
+            SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+            return true;
+        }
+        if (SPSC_FIFO_ATOMIC_LOAD(&(fifo->closed), SPSC_FIFO_MEMORY_ORDER_SEQ_CST)) {
+            SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_waiting), false, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+            return spsc_fifo_readable(fifo, read_count, amount) >= amount;
+        }
+
+        if (!spsc_fifo_park(&(fifo->consumer_wake), wake, deadline, fifo->kind == spsc_fifo_kind_shm)) {
+            SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+            return spsc_fifo_readable(fifo, read_count, amount) >= amount;
+        }
+    }
 }
 
-SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_write_avail(spsc_fifo *fifo) {
+SPSC_FIFO_IMPL bool spsc_fifo_wait_writable(spsc_fifo *fifo, spsc_fifo_usize amount, const struct timespec *deadline) {
     SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
 
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (amount > fifo->capacity) {
+        return false;
+    }
 
-    return fifo->capacity - (write_count - read_count);
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    for (unsigned spin = 0; spin < SPSC_FIFO_SPIN_COUNT; ++spin) {
+        if (spsc_fifo_writable(fifo, write_count, amount) >= amount) {
+            return true;
+        }
+        SPSC_FIFO_CPU_RELAX();
+    }
+
+    while (true) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_waiting), true, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+        const spsc_fifo_usize wake       = SPSC_FIFO_ATOMIC_LOAD(&(fifo->producer_wake), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+        const spsc_fifo_usize read_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+        fifo->read_count_cache = read_count;
+        if (fifo->capacity - (write_count - read_count) >= amount) {
+            SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+            return true;
+        }
+        if (SPSC_FIFO_ATOMIC_LOAD(&(fifo->closed), SPSC_FIFO_MEMORY_ORDER_SEQ_CST)) {
+            SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_waiting), false, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+            return false;
+        }
+
+        if (!spsc_fifo_park(&(fifo->producer_wake), wake, deadline, fifo->kind == spsc_fifo_kind_shm)) {
+            SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+            return spsc_fifo_writable(fifo, write_count, amount) >= amount;
+        }
+    }
 }
 
-SPSC_FIFO_IMPL bool spsc_fifo_is_full(spsc_fifo *fifo) {
-    return spsc_fifo_write_avail(fifo) == 0;
+SPSC_FIFO_IMPL bool spsc_fifo_read_n_wait(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize len, const struct timespec *deadline) {
+    return len != 0 && spsc_fifo_wait_readable(fifo, len, deadline) && spsc_fifo_read_n(fifo, to, len);
 }
 
-SPSC_FIFO_IMPL spsc_fifo_usize spsc_fifo_write(spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+SPSC_FIFO_IMPL bool spsc_fifo_write_n_wait(spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len, const struct timespec *deadline) {
+    return len != 0 && spsc_fifo_wait_writable(fifo, len, deadline) && spsc_fifo_write_n(fifo, from, len);
+}
+
+SPSC_FIFO_IMPL spsc_fifo *spsc_fifo_group_wait_ready(spsc_fifo_group *group, const struct timespec *deadline) {
+    for (unsigned spin = 0; spin < SPSC_FIFO_SPIN_COUNT; ++spin) {
+        spsc_fifo *fifo = spsc_fifo_group_next_ready(group);
+        if (fifo != NULL) {
+            return fifo;
+        }
+        SPSC_FIFO_CPU_RELAX();
+    }
+
+    while (true) {
+        SPSC_FIFO_ATOMIC_STORE(&(group->waiting), true, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+        const spsc_fifo_usize epoch = SPSC_FIFO_ATOMIC_LOAD(&(group->epoch), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+
+        spsc_fifo *fifo = spsc_fifo_group_next_ready(group);
+        if (fifo != NULL) {
+            SPSC_FIFO_ATOMIC_STORE(&(group->waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+            return fifo;
+        }
+
+        if (!spsc_fifo_park(&(group->epoch), epoch, deadline, false)) {
+            SPSC_FIFO_ATOMIC_STORE(&(group->waiting), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+            return spsc_fifo_group_next_ready(group);
+        }
+    }
+}
+#endif
+
+SPSC_FIFO_IMPL bool spsc_fifo_set_record_format(spsc_fifo *fifo, spsc_fifo_usize alignment, bool contiguous) {
+    if (!spsc_fifo_is_pow_2(alignment) || alignment < SPSC_FIFO_RECORD_HEADER_SIZE || alignment > fifo->capacity) {
+        return false;
+    }
+
+    fifo->record_alignment  = alignment;
+    fifo->record_contiguous = contiguous;
+
+    return true;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_push_record(spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) {
     SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
 
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (len > fifo->capacity - SPSC_FIFO_RECORD_HEADER_SIZE) {
+        return false;
+    }
 
-    const spsc_fifo_usize write_avail = fifo->capacity - (write_count - read_count);
-    if (len > write_avail) {
-        len = write_avail;
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    const spsc_fifo_usize write_idx   = write_count & fifo->mask;
+    const spsc_fifo_usize stride      = spsc_fifo_record_stride(fifo, len);
+    if (stride > fifo->capacity) {
+        return false;
     }
 
-    if (len == 0) {
-        return 0;
+    spsc_fifo_usize pad = 0;
+    if (fifo->record_contiguous && stride > fifo->span - write_idx) {
+        pad = fifo->span - write_idx;
     }
 
-    const spsc_fifo_usize write_idx = write_count & fifo->mask;
-    const spsc_fifo_usize l = spsc_fifo_min(len, fifo->capacity - write_idx);
-    memcpy(fifo->buf + write_idx, from, l);
-    if (l < len) {
-        memcpy(fifo->buf, from + l, len - l);
+    const spsc_fifo_usize write_avail = spsc_fifo_writable(fifo, write_count, pad + stride);
+    if (pad + stride > write_avail) {
+        SPSC_FIFO_STATS_ADD(fifo, write_full, 1);
+        /* The record can never fit behind the padding, publish the padding alone so the next attempt starts at
+           the beginning of the buffer once the consumer catches up. */
+        if (pad != 0 && pad + stride > fifo->capacity && pad <= write_avail) {
+            const spsc_fifo_usize marker = SPSC_FIFO_RECORD_PAD;
+            memcpy(spsc_fifo_buf(fifo) + write_idx, &marker, SPSC_FIFO_RECORD_HEADER_SIZE);
+            fifo->write_shadow = write_count + pad;
+            spsc_fifo_publish_write(fifo, fifo->write_shadow);
+        }
+        return false;
+    }
+
+    if (pad != 0) {
+        const spsc_fifo_usize marker = SPSC_FIFO_RECORD_PAD;
+        memcpy(spsc_fifo_buf(fifo) + write_idx, &marker, SPSC_FIFO_RECORD_HEADER_SIZE);
     }
 
-    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), write_count + len, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    const spsc_fifo_usize record_idx = (write_count + pad) & fifo->mask;
+    memcpy(spsc_fifo_buf(fifo) + record_idx, &len, SPSC_FIFO_RECORD_HEADER_SIZE);
+    spsc_fifo_copy_to_buf(fifo, (record_idx + SPSC_FIFO_RECORD_HEADER_SIZE) & fifo->mask, from, len);
 
-    return len;
+    spsc_fifo_advance_write(fifo, write_count + pad + stride);
+
+    return true;
 }
 
-SPSC_FIFO_IMPL bool spsc_fifo_write_n(spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) {
+SPSC_FIFO_IMPL bool spsc_fifo_peek_record_len(spsc_fifo *fifo, spsc_fifo_usize *len) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    spsc_fifo_usize read_count = fifo->read_shadow;
+
+    return spsc_fifo_record_front(fifo, &read_count, len);
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_pop_record(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max, spsc_fifo_usize *len) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    spsc_fifo_usize read_count = fifo->read_shadow;
+    if (!spsc_fifo_record_front(fifo, &read_count, len)) {
+        spsc_fifo_record_release_pad(fifo, read_count);
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, 1);
+        return false;
+    }
+    if (*len > max) {
+        return false;
+    }
+
+    spsc_fifo_copy_from_buf(fifo, (read_count + SPSC_FIFO_RECORD_HEADER_SIZE) & fifo->mask, to, *len);
+
+    spsc_fifo_advance_read(fifo, read_count + spsc_fifo_record_stride(fifo, *len));
+
+    return true;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_skip_record(spsc_fifo *fifo) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    spsc_fifo_usize read_count = fifo->read_shadow;
+    spsc_fifo_usize len;
+    if (!spsc_fifo_record_front(fifo, &read_count, &len)) {
+        spsc_fifo_record_release_pad(fifo, read_count);
+        SPSC_FIFO_STATS_ADD(fifo, read_empty, 1);
+        return false;
+    }
+
+    spsc_fifo_advance_read(fifo, read_count + spsc_fifo_record_stride(fifo, len));
+
+    return true;
+}
+
+/* Works like a seqlock: lossy_oldest is moved past every record about to be overwritten before its bytes are
+   touched, and the consumer checks it again after copying a record, so a torn copy is always detected. Every
+   record is published at once, whatever the write batch, so lossy_oldest never runs ahead of write_count. */
+SPSC_FIFO_IMPL bool spsc_fifo_push_lossy(spsc_fifo *fifo, const spsc_fifo_byte *from, spsc_fifo_usize len) {
     SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
 
-    const spsc_fifo_usize read_count  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count),  SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
-    const spsc_fifo_usize write_count = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (len > fifo->capacity - sizeof(struct spsc_fifo_lossy_header)) {
+        return false;
+    }
 
-    const spsc_fifo_usize write_avail = fifo->capacity - (write_count - read_count);
-    if (len == 0 || len > write_avail) {
+    const spsc_fifo_usize stride = spsc_fifo_lossy_stride(len);
+    if (stride > fifo->capacity) {
         return false;
     }
 
-    const spsc_fifo_usize write_idx = write_count & fifo->mask;
-    const spsc_fifo_usize l = spsc_fifo_min(len, fifo->capacity - write_idx);
-    memcpy(fifo->buf + write_idx, from, l);
-    if (l < len) {
-        memcpy(fifo->buf, from + l, len - l);
+    const spsc_fifo_usize write_count = fifo->write_shadow;
+    spsc_fifo_usize oldest = SPSC_FIFO_ATOMIC_LOAD(&(fifo->lossy_oldest), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    if (write_count + stride - oldest > fifo->capacity) {
+        /* Each record is stepped over once, so this stays constant time per record on average. */
+        do {
+            struct spsc_fifo_lossy_header header;
+            spsc_fifo_lossy_header_at(fifo, oldest, &header);
+            oldest += spsc_fifo_lossy_stride(header.len);
+        } while (write_count + stride - oldest > fifo->capacity);
+
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->lossy_oldest), oldest, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_THREAD_FENCE(SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    }
+
+    const struct spsc_fifo_lossy_header header = {.pos = write_count, .len = len, .index = fifo->lossy_index++};
+    spsc_fifo_copy_to_buf(fifo, write_count & fifo->mask, (const spsc_fifo_byte*)&header, sizeof(header));
+    spsc_fifo_copy_to_buf(fifo, (write_count + sizeof(header)) & fifo->mask, from, len);
+
+    spsc_fifo_advance_write(fifo, write_count + stride);
+    spsc_fifo_flush_pending_write(fifo);
+
+    return true;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_pop_lossy(spsc_fifo *fifo, spsc_fifo_byte *to, spsc_fifo_usize max, spsc_fifo_usize *len, unsigned long long *lost) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    spsc_fifo_usize read_count = fifo->read_shadow;
+    while (true) {
+        /* oldest first: its acquire makes the write_count published before it moved visible, so the count loaded
+           next is never behind it. Distances back from that count are then well defined however far the consumer
+           trails, where comparing read_count and oldest directly breaks down past half the counter range. */
+        const spsc_fifo_usize oldest = SPSC_FIFO_ATOMIC_LOAD(&(fifo->lossy_oldest), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+        fifo->write_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+
+        const spsc_fifo_usize read_avail = fifo->write_count_cache - read_count;
+        if (read_avail == 0) {
+            SPSC_FIFO_STATS_ADD(fifo, read_empty, 1);
+            return false;
+        }
+
+        /* Lapped: more behind than the producer keeps, which includes any lag beyond capacity. */
+        if (read_avail > fifo->write_count_cache - oldest) {
+            fifo->lossy_lost_bytes += oldest - read_count;
+            read_count = oldest;
+            fifo->read_shadow = read_count;
+            continue;
+        }
+
+        struct spsc_fifo_lossy_header header;
+        spsc_fifo_lossy_header_at(fifo, read_count, &header);
+
+        const bool intact = header.pos == read_count && header.len <= fifo->capacity &&
+                            spsc_fifo_lossy_stride(header.len) <= read_avail;
+        if (intact && header.len <= max) {
+            spsc_fifo_copy_from_buf(fifo, (read_count + sizeof(header)) & fifo->mask, to, header.len);
+        }
+
+        SPSC_FIFO_ATOMIC_THREAD_FENCE(SPSC_FIFO_MEMORY_ORDER_ACQUIRE);
+        const spsc_fifo_usize oldest_after = SPSC_FIFO_ATOMIC_LOAD(&(fifo->lossy_oldest), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+        /* Overwritten while reading, or no record starts here: resume at the oldest record, which always moves the
+           cursor since an intact record at the oldest position is only torn by moving oldest past it. */
+        if (!intact || oldest_after - oldest > read_count - oldest) {
+            fifo->lossy_lost_bytes += oldest_after - read_count;
+            read_count = oldest_after;
+            fifo->read_shadow = read_count;
+            continue;
+        }
+
+        *len = header.len;
+        if (header.len > max) {
+            return false;
+        }
+
+        *lost = header.index - fifo->lossy_next;
+        fifo->lossy_lost_records += *lost;
+        fifo->lossy_next = header.index + 1;
+
+        spsc_fifo_advance_read(fifo, read_count + spsc_fifo_lossy_stride(header.len));
+
+        return true;
+    }
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_lossy_lost(spsc_fifo *fifo, unsigned long long *records, unsigned long long *bytes) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    *records = fifo->lossy_lost_records;
+    *bytes   = fifo->lossy_lost_bytes;
+}
+
+#ifdef SPSC_FIFO_STATS
+SPSC_FIFO_IMPL void spsc_fifo_stats_snapshot(spsc_fifo *fifo, spsc_fifo_stats *stats) {
+    stats->bytes_written  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_bytes_written),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->writes         = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_writes),         SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->write_full     = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_write_full),     SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->partial_writes = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_partial_writes), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->write_splits   = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_write_splits),   SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->high_water     = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_high_water),     SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->bytes_read     = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_bytes_read),     SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->reads          = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_reads),          SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->read_empty     = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_read_empty),     SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->partial_reads  = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_partial_reads),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->read_splits    = SPSC_FIFO_ATOMIC_LOAD(&(fifo->stats_read_splits),    SPSC_FIFO_MEMORY_ORDER_RELAXED);
+}
+#endif
+
+#ifdef SPSC_FIFO_EVENTFD
+SPSC_FIFO_IMPL bool spsc_fifo_enable_fds(spsc_fifo *fifo) {
+#ifdef SPSC_FIFO_LINUX
+    if (fifo->read_fd >= 0) {
+        return true;
+    }
+    if (fifo->kind == spsc_fifo_kind_shm || fifo->kind == spsc_fifo_kind_file) {
+        return false;
+    }
+
+    const int read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (read_fd < 0) {
+        return false;
+    }
+    const int write_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (write_fd < 0) {
+        close(read_fd);
+        return false;
+    }
+
+    fifo->read_fd  = read_fd;
+    fifo->write_fd = write_fd;
+
+    return true;
+#else
+    SPSC_FIFO_IGNORE(fifo);
+    return false;
+#endif
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_read_fd(spsc_fifo *fifo) {
+    return fifo->read_fd;
+}
+
+SPSC_FIFO_IMPL int spsc_fifo_write_fd(spsc_fifo *fifo) {
+    return fifo->write_fd;
+}
+
+/* Same handshake as spsc_fifo_wait_readable, with the eventfd in place of the futex. */
+SPSC_FIFO_IMPL bool spsc_fifo_arm_read_fd(spsc_fifo *fifo, spsc_fifo_usize amount) {
+    SPSC_FIFO_ASSERT_CONSUMER_THREAD(fifo);
+
+    if (fifo->read_fd < 0 || amount == 0 || amount > fifo->capacity) {
+        return false;
+    }
+
+    spsc_fifo_flush_pending_read(fifo);
+    spsc_fifo_event_drain(fifo->read_fd);
+
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_armed), amount, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    fifo->write_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->write_count), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    if (fifo->write_count_cache - fifo->read_shadow >= amount || SPSC_FIFO_ATOMIC_LOAD(&(fifo->closed), SPSC_FIFO_MEMORY_ORDER_SEQ_CST)) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->consumer_armed), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        return false;
     }
 
-    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), write_count + len, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+    return true;
+}
+
+SPSC_FIFO_IMPL bool spsc_fifo_arm_write_fd(spsc_fifo *fifo, spsc_fifo_usize amount) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    if (fifo->write_fd < 0 || amount == 0 || amount > fifo->capacity) {
+        return false;
+    }
+
+    spsc_fifo_flush_pending_write(fifo);
+    spsc_fifo_event_drain(fifo->write_fd);
+
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_armed), amount, SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    fifo->read_count_cache = SPSC_FIFO_ATOMIC_LOAD(&(fifo->read_count), SPSC_FIFO_MEMORY_ORDER_SEQ_CST);
+    if (fifo->capacity - (fifo->write_shadow - fifo->read_count_cache) >= amount || SPSC_FIFO_ATOMIC_LOAD(&(fifo->closed), SPSC_FIFO_MEMORY_ORDER_SEQ_CST)) {
+        SPSC_FIFO_ATOMIC_STORE(&(fifo->producer_armed), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        return false;
+    }
 
     return true;
 }
+#endif
+
+#ifdef SPSC_FIFO_TRACE
+SPSC_FIFO_IMPL void spsc_fifo_set_trace_rate(spsc_fifo *fifo, unsigned every) {
+    SPSC_FIFO_ASSERT_PRODUCER_THREAD(fifo);
+
+    fifo->trace_rate      = every;
+    fifo->trace_countdown = every;
+}
+
+SPSC_FIFO_IMPL void spsc_fifo_trace_snapshot(spsc_fifo *fifo, spsc_fifo_trace *trace) {
+    trace->samples = SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_samples), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    trace->dropped = SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_dropped), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    for (unsigned i = 0; i < SPSC_FIFO_TRACE_BUCKETS; ++i) {
+        trace->buckets[i] = SPSC_FIFO_ATOMIC_LOAD(&(fifo->trace_buckets[i]), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    }
+}
+
+SPSC_FIFO_IMPL unsigned long long spsc_fifo_trace_bucket_min(unsigned bucket) {
+    const unsigned sub = 1u << SPSC_FIFO_TRACE_SUB_BITS;
+    if (bucket < sub) {
+        return bucket;
+    }
+
+    return (unsigned long long)(sub + bucket % sub) << (bucket / sub - 1);
+}
+
+SPSC_FIFO_IMPL unsigned long long spsc_fifo_trace_percentile(const spsc_fifo_trace *trace, double fraction) {
+    unsigned long long total = 0;
+    for (unsigned i = 0; i < SPSC_FIFO_TRACE_BUCKETS; ++i) {
+        total += trace->buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const unsigned long long rank = fraction <= 0.0 ? 1 : fraction >= 1.0 ? total : (unsigned long long)(fraction * (double)total) + 1;
+    unsigned long long seen = 0;
+    for (unsigned i = 0; i < SPSC_FIFO_TRACE_BUCKETS; ++i) {
+        seen += trace->buckets[i];
+        if (seen >= rank) {
+            return spsc_fifo_trace_bucket_min(i);
+        }
+    }
+
+    return spsc_fifo_trace_bucket_min(SPSC_FIFO_TRACE_BUCKETS - 1);
+}
+#endif
 
 #endif //SPSC_FIFO_IMPLEMENTATION
 
@@ -0,0 +1,306 @@
+/* spsc-fifo.hpp - v1.0 - C++20 wrapper for spsc-fifo.h
+                                   no warranty implied; use at your own risk
+
+   spsc::fifo               - move-only owner of a spsc_fifo, byte and trivially copyable object I/O,
+                              std::span views over acquired/reserved regions
+   spsc::typed_fifo<T, Cap> - header-only queue of T with compile-time capacity and inline storage, elements
+                              are constructed in place in the ring
+
+   Every spsc::fifo member is an inline forwarding call, spsc_fifo functions still need the implementation
+   compiled in some C translation unit (the implementation section is C only). spsc::typed_fifo needs nothing
+   else. Thread roles are as in the C API: one producer thread, one consumer thread.
+
+   Usage:
+     #include "spsc-fifo.hpp"
+
+   License: MIT (see end of file for license information)
+*/
+
+#ifndef SPSC_FIFO_HPP
+#define SPSC_FIFO_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "spsc-fifo.h"
+
+namespace spsc {
+
+#ifdef SPSC_FIFO_CACHE_LINE_SIZE
+inline constexpr std::size_t cache_line_size = SPSC_FIFO_CACHE_LINE_SIZE;
+#else
+inline constexpr std::size_t cache_line_size = 64;
+#endif
+
+using usize = spsc_fifo_usize;
+
+/* Owner of a heap allocated FIFO. Allocation failures throw, like any other C++ resource acquisition. */
+class fifo {
+public:
+    explicit fifo(usize min_capacity) {
+        check(spsc_fifo_alloc(&fifo_, min_capacity));
+    }
+
+    fifo(usize min_capacity, usize buf_alignment) {
+        check(spsc_fifo_aligned_alloc(&fifo_, min_capacity, buf_alignment));
+    }
+
+    /* Takes ownership of a FIFO allocated through the C API. */
+    static fifo adopt(spsc_fifo *handle) noexcept {
+        return fifo(handle);
+    }
+
+    fifo(const fifo&) = delete;
+    fifo& operator=(const fifo&) = delete;
+
+    fifo(fifo&& other) noexcept : fifo_(std::exchange(other.fifo_, nullptr)) {}
+
+    fifo& operator=(fifo&& other) noexcept {
+        if (this != &other) {
+            reset_handle();
+            fifo_ = std::exchange(other.fifo_, nullptr);
+        }
+        return *this;
+    }
+
+    ~fifo() {
+        reset_handle();
+    }
+
+    spsc_fifo *get() const noexcept { return fifo_; }
+    spsc_fifo *release() noexcept { return std::exchange(fifo_, nullptr); }
+    explicit operator bool() const noexcept { return fifo_ != nullptr; }
+
+    /* Producer */
+    usize write_avail() noexcept { return spsc_fifo_write_avail(fifo_); }
+    bool is_full() noexcept { return spsc_fifo_is_full(fifo_); }
+    usize write(std::span<const std::byte> from) noexcept { return spsc_fifo_write(fifo_, bytes(from), len(from)); }
+    bool write_n(std::span<const std::byte> from) noexcept { return spsc_fifo_write_n(fifo_, bytes(from), len(from)); }
+    void flush_write() noexcept { spsc_fifo_flush_write(fifo_); }
+    void close_write() noexcept { spsc_fifo_close_write(fifo_); }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    bool push(const T& value) noexcept {
+        return spsc_fifo_write_n(fifo_, reinterpret_cast<const spsc_fifo_byte*>(std::addressof(value)), sizeof(T));
+    }
+
+    /* Up to two writable regions, publish what was written into them with commit. */
+    std::array<std::span<std::byte>, 2> reserve(usize max) noexcept {
+        spsc_fifo_region regions[2];
+        spsc_fifo_write_reserve(fifo_, regions, max);
+        return {span(regions[0]), span(regions[1])};
+    }
+
+    void commit(usize len) noexcept { spsc_fifo_write_commit(fifo_, len); }
+
+    /* Consumer */
+    usize read_avail() noexcept { return spsc_fifo_read_avail(fifo_); }
+    bool is_empty() noexcept { return spsc_fifo_is_empty(fifo_); }
+    bool is_eof() noexcept { return spsc_fifo_is_eof(fifo_); }
+    usize read(std::span<std::byte> to) noexcept { return spsc_fifo_read(fifo_, bytes(to), len(to)); }
+    bool read_n(std::span<std::byte> to) noexcept { return spsc_fifo_read_n(fifo_, bytes(to), len(to)); }
+    usize peek(std::span<std::byte> to) noexcept { return spsc_fifo_peek(fifo_, bytes(to), len(to)); }
+    bool peek_n(std::span<std::byte> to) noexcept { return spsc_fifo_peek_n(fifo_, bytes(to), len(to)); }
+    usize skip(usize amount) noexcept { return spsc_fifo_skip(fifo_, amount); }
+    bool skip_n(usize amount) noexcept { return spsc_fifo_skip_n(fifo_, amount); }
+    void flush_read() noexcept { spsc_fifo_flush_read(fifo_); }
+    void close_read() noexcept { spsc_fifo_close_read(fifo_); }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    bool pop(T& value) noexcept {
+        return spsc_fifo_read_n(fifo_, reinterpret_cast<spsc_fifo_byte*>(std::addressof(value)), sizeof(T));
+    }
+
+    /* Up to two readable regions, free what was consumed from them with consume. */
+    std::array<std::span<const std::byte>, 2> readable(usize max) noexcept {
+        spsc_fifo_region regions[2];
+        spsc_fifo_read_acquire(fifo_, regions, max);
+        return {span(regions[0]), span(regions[1])};
+    }
+
+    void consume(usize len) noexcept { spsc_fifo_read_release(fifo_, len); }
+
+private:
+    explicit fifo(spsc_fifo *handle) noexcept : fifo_(handle) {}
+
+    static void check(int status) {
+        if (status == spsc_fifo_alloc_nomem) {
+            throw std::bad_alloc();
+        }
+        if (status != spsc_fifo_alloc_success) {
+            throw std::invalid_argument("spsc::fifo: unsupported capacity or alignment");
+        }
+    }
+
+    void reset_handle() noexcept {
+        if (fifo_ != nullptr) {
+            spsc_fifo_free(&fifo_);
+        }
+    }
+
+    static spsc_fifo_byte *bytes(std::span<std::byte> s) noexcept { return reinterpret_cast<spsc_fifo_byte*>(s.data()); }
+    static const spsc_fifo_byte *bytes(std::span<const std::byte> s) noexcept { return reinterpret_cast<const spsc_fifo_byte*>(s.data()); }
+    static usize len(std::span<const std::byte> s) noexcept { return static_cast<usize>(s.size()); }
+    static std::span<std::byte> span(const spsc_fifo_region& r) noexcept { return {reinterpret_cast<std::byte*>(r.ptr), r.len}; }
+
+    spsc_fifo *fifo_ = nullptr;
+};
+
+/* Queue of T in an inline ring of Capacity slots. Same layout rules as spsc_fifo: each side's counter and its
+   cached copy of the other side's counter share a cache line owned by that side. Not movable, the storage is
+   part of the object; put it in a std::unique_ptr to hand it around.
+
+   This is not a wrapper over SPSC_FIFO_DEFINE_TYPED: that generator is C only (_Atomic counters, _Alignas,
+   compiled out under __cplusplus) and copies elements in as bytes, while T here may have constructors and
+   destructors that have to run in the slot. The counter protocol is the same one. */
+template <class T, usize Capacity>
+class typed_fifo {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    using value_type = T;
+
+    static constexpr usize capacity = Capacity;
+    static constexpr usize mask = Capacity - 1;
+
+    typed_fifo() noexcept = default;
+    typed_fifo(const typed_fifo&) = delete;
+    typed_fifo& operator=(const typed_fifo&) = delete;
+
+    ~typed_fifo() {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (usize i = consumer_.shadow; i != producer_.count.load(std::memory_order_acquire); ++i) {
+                std::destroy_at(slot(i));
+            }
+        }
+    }
+
+    /* Producer: constructs an element in the next free slot and publishes it, false when full. */
+    template <class... Args>
+    bool try_emplace(Args&&... args) noexcept(std::is_nothrow_constructible_v<T, Args...>) {
+        const usize write_count = producer_.shadow;
+        if (write_count - producer_.cache == Capacity) {
+            producer_.cache = consumer_.count.load(std::memory_order_acquire);
+            if (write_count - producer_.cache == Capacity) {
+                return false;
+            }
+        }
+
+        std::construct_at(slot(write_count), std::forward<Args>(args)...);
+        producer_.shadow = write_count + 1;
+        producer_.count.store(write_count + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(const T& value) noexcept(std::is_nothrow_copy_constructible_v<T>) { return try_emplace(value); }
+    bool try_push(T&& value) noexcept(std::is_nothrow_move_constructible_v<T>) { return try_emplace(std::move(value)); }
+
+    /* Consumer: oldest element or nullptr, release it with pop. */
+    T *front() noexcept {
+        const usize read_count = consumer_.shadow;
+        if (read_count == consumer_.cache) {
+            consumer_.cache = producer_.count.load(std::memory_order_acquire);
+            if (read_count == consumer_.cache) {
+                return nullptr;
+            }
+        }
+        return slot(read_count);
+    }
+
+    /* Consumer: destroys the element returned by front. */
+    void pop() noexcept {
+        const usize read_count = consumer_.shadow;
+        std::destroy_at(slot(read_count));
+        consumer_.shadow = read_count + 1;
+        consumer_.count.store(read_count + 1, std::memory_order_release);
+    }
+
+    bool try_pop(T& value) noexcept(std::is_nothrow_move_assignable_v<T>) {
+        T *element = front();
+        if (element == nullptr) {
+            return false;
+        }
+        value = std::move(*element);
+        pop();
+        return true;
+    }
+
+    /* Consumer: every readable element as up to two contiguous views, release them with consume. */
+    std::array<std::span<T>, 2> readable() noexcept {
+        const usize read_count = consumer_.shadow;
+        consumer_.cache = producer_.count.load(std::memory_order_acquire);
+
+        const usize avail = consumer_.cache - read_count;
+        const usize first = std::min(avail, Capacity - (read_count & mask));
+        return {std::span<T>(slot(read_count), first), std::span<T>(slot(0), avail - first)};
+    }
+
+    /* Consumer: destroys and releases the oldest n elements, n at most what readable returned. */
+    void consume(usize n) noexcept {
+        const usize read_count = consumer_.shadow;
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (usize i = 0; i < n; ++i) {
+                std::destroy_at(slot(read_count + i));
+            }
+        }
+        consumer_.shadow = read_count + n;
+        consumer_.count.store(read_count + n, std::memory_order_release);
+    }
+
+    bool is_empty() noexcept { return front() == nullptr; }
+
+    bool is_full() noexcept {
+        producer_.cache = consumer_.count.load(std::memory_order_acquire);
+        return producer_.shadow - producer_.cache == Capacity;
+    }
+
+private:
+    T *slot(usize count) noexcept {
+        return std::launder(reinterpret_cast<T*>(storage_ + (count & mask) * sizeof(T)));
+    }
+
+    struct side {
+        std::atomic<usize> count{0};
+        usize shadow = 0; /* own position, equal to count, kept to avoid reloading the atomic */
+        usize cache = 0;  /* last seen position of the other side */
+    };
+
+    alignas(cache_line_size) side producer_;
+    alignas(cache_line_size) side consumer_;
+    alignas(cache_line_size) alignas(T) std::byte storage_[Capacity * sizeof(T)];
+};
+
+} // namespace spsc
+
+#endif //SPSC_FIFO_HPP
+
+/*
+   Copyright 2025 Karlo Bratko <kbratko@tuta.io>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+   and associated documentation files (the “Software”), to deal in the Software without
+   restriction, including without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in all copies or
+   substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,445 @@
+/* spsc-pipeline.h - v1.0 - Thread Pipeline Runtime on top of spsc-fifo.h
+                                   no warranty implied; use at your own risk
+
+   Runs a linear chain of stages, each on its own thread, connected by SPSC FIFOs: stage i reads the FIFO
+   written by stage i - 1. The runtime owns the threads, FIFO binding, CPU pinning, idle waiting and
+   termination; stages only move data.
+
+   A stage callback is called in a loop and returns spsc_pipeline_progress when it moved data,
+   spsc_pipeline_idle when its input was empty or its output full (backpressure), or spsc_pipeline_done when it
+   has finished. End of stream and shutdown travel through the FIFOs themselves:
+     - the first stage finishing (or spsc_pipeline_stop) closes its output, every later stage drains its input
+       and then closes its own output once the input is closed and empty;
+     - a stage finishing early closes its input as well, the stage before it stops at its next idle call.
+
+   Usage:
+     #define SPSC_PIPELINE_IMPLEMENTATION
+     #include "spsc-pipeline.h"
+
+   spsc-fifo.h is included by this header, its implementation must be compiled in some translation unit.
+
+   Options:
+     #define SPSC_PIPELINE_STATIC            - if static functions are preferred
+     #define SPSC_PIPELINE_SPIN_COUNT        - override idle calls before a backoff stage yields (default: 1024)
+     #define SPSC_PIPELINE_YIELD_COUNT       - override yields before a backoff stage sleeps (default: 64)
+     #define SPSC_PIPELINE_SLEEP_NS          - override backoff sleep, also the block wait slice (default: 50000)
+
+   License: MIT (see end of file for license information)
+*/
+
+#ifndef SPSC_PIPELINE_H
+#define SPSC_PIPELINE_H
+
+#include "spsc-fifo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#undef SPSC_PIPELINE_DEF
+#ifdef SPSC_PIPELINE_STATIC
+    #define SPSC_PIPELINE_DEF static
+#else
+    #define SPSC_PIPELINE_DEF extern
+#endif
+
+/* Types */
+typedef struct spsc_pipeline spsc_pipeline;
+
+enum spsc_pipeline_status {
+    spsc_pipeline_progress,
+    spsc_pipeline_idle,
+    spsc_pipeline_done,
+};
+
+/* What a stage does while its callback keeps returning spsc_pipeline_idle */
+enum spsc_pipeline_wait {
+    spsc_pipeline_wait_spin,    /* busy-wait, lowest latency, burns its core */
+    spsc_pipeline_wait_backoff, /* spin, then yield, then sleep SPSC_PIPELINE_SLEEP_NS */
+    spsc_pipeline_wait_block,   /* park on the FIFO that blocks progress, needs SPSC_FIFO_WAIT (backoff otherwise) */
+};
+
+/* in is NULL for the first stage, out is NULL for the last one */
+typedef int (*spsc_pipeline_stage_fn)(spsc_fifo *in, spsc_fifo *out, void *arg);
+
+typedef struct spsc_pipeline_stage {
+    spsc_pipeline_stage_fn fn;
+    void *arg;
+    int cpu;  /* CPU to pin the stage thread to, -1 for no pinning */
+    int wait; /* spsc_pipeline_wait */
+} spsc_pipeline_stage;
+
+/* Per-stage counters, utilization is the share of run time not spent idle-waiting */
+typedef struct spsc_pipeline_stage_stats {
+    unsigned long long progress; /* callback calls returning spsc_pipeline_progress */
+    unsigned long long idle;     /* callback calls returning spsc_pipeline_idle */
+    unsigned long long run_ns;
+    unsigned long long idle_ns;
+    double utilization;
+    bool pinned;
+} spsc_pipeline_stage_stats;
+
+/* Management functions, stages are copied, FIFOs between them have at least fifo_capacity bytes */
+SPSC_PIPELINE_DEF int  spsc_pipeline_alloc(spsc_pipeline **pipeline, const spsc_pipeline_stage *stages, unsigned count, spsc_fifo_usize fifo_capacity);
+SPSC_PIPELINE_DEF void spsc_pipeline_free (spsc_pipeline **pipeline);
+
+SPSC_PIPELINE_DEF bool spsc_pipeline_start(spsc_pipeline *pipeline);
+SPSC_PIPELINE_DEF void spsc_pipeline_stop (spsc_pipeline *pipeline); /* end the stream at the first stage, the rest drain */
+SPSC_PIPELINE_DEF bool spsc_pipeline_join (spsc_pipeline *pipeline);
+
+/* Safe to call while the pipeline runs */
+SPSC_PIPELINE_DEF void spsc_pipeline_stats(spsc_pipeline *pipeline, unsigned stage, spsc_pipeline_stage_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SPSC_PIPELINE_H
+
+#ifdef SPSC_PIPELINE_IMPLEMENTATION
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+
+#if defined(__linux__) && (!defined(__STRICT_ANSI__) || defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE))
+#define SPSC_PIPELINE_AFFINITY
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#undef SPSC_PIPELINE_UTIL
+#define SPSC_PIPELINE_UTIL static inline
+
+#undef SPSC_PIPELINE_IMPL
+#ifdef SPSC_PIPELINE_STATIC
+    #define SPSC_PIPELINE_IMPL static inline
+#else
+    #define SPSC_PIPELINE_IMPL extern inline
+#endif
+
+#undef SPSC_PIPELINE_CPU_RELAX
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define SPSC_PIPELINE_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__GNUC__) && defined(__aarch64__)
+    #define SPSC_PIPELINE_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+    #define SPSC_PIPELINE_CPU_RELAX() ((void)0)
+#endif
+
+#ifndef SPSC_PIPELINE_SPIN_COUNT
+#define SPSC_PIPELINE_SPIN_COUNT 1024
+#endif
+
+#ifndef SPSC_PIPELINE_YIELD_COUNT
+#define SPSC_PIPELINE_YIELD_COUNT 64
+#endif
+
+#ifndef SPSC_PIPELINE_SLEEP_NS
+#define SPSC_PIPELINE_SLEEP_NS 50000
+#endif
+
+#undef SPSC_PIPELINE_NS_IN_S
+#define SPSC_PIPELINE_NS_IN_S 1000000000ULL
+
+/* Counters are written by the stage thread only and read by anyone, hence the plain load + store. */
+struct spsc_pipeline_worker {
+    _Alignas(SPSC_FIFO_CACHE_LINE_SIZE) SPSC_FIFO_ATOMIC(unsigned long long) progress;
+    SPSC_FIFO_ATOMIC(unsigned long long) idle;
+    SPSC_FIFO_ATOMIC(unsigned long long) start_ns;
+    SPSC_FIFO_ATOMIC(unsigned long long) end_ns; /* 0 while running */
+    SPSC_FIFO_ATOMIC(unsigned long long) idle_ns;
+    SPSC_FIFO_ATOMIC(bool) pinned;
+    spsc_pipeline_stage stage;
+    spsc_fifo *in;
+    spsc_fifo *out;
+    spsc_pipeline *pipeline;
+    thrd_t thrd;
+    bool started;
+};
+
+struct spsc_pipeline {
+    struct spsc_pipeline_worker *workers;
+    spsc_fifo **fifos; /* count - 1 FIFOs, fifos[i] connects stage i to stage i + 1 */
+    void *mem;
+    unsigned count;
+    SPSC_FIFO_ATOMIC(bool) stopping;
+};
+
+SPSC_PIPELINE_UTIL unsigned long long spsc_pipeline_now_ns(void) {
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (unsigned long long)ts.tv_sec * SPSC_PIPELINE_NS_IN_S + (unsigned long long)ts.tv_nsec;
+}
+
+SPSC_PIPELINE_UTIL void spsc_pipeline_count(SPSC_FIFO_ATOMIC(unsigned long long) *counter, unsigned long long n) {
+    SPSC_FIFO_ATOMIC_STORE(counter, SPSC_FIFO_ATOMIC_LOAD(counter, SPSC_FIFO_MEMORY_ORDER_RELAXED) + n, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+}
+
+/* Pins the calling thread, false where affinity is unsupported or the CPU does not exist. */
+SPSC_PIPELINE_UTIL bool spsc_pipeline_pin(int cpu) {
+#if defined(SPSC_PIPELINE_AFFINITY) && defined(SYS_sched_setaffinity)
+    unsigned long mask[16] = {0};
+    const unsigned bits = sizeof(*mask) * 8;
+    if (cpu < 0 || (unsigned)cpu >= bits * (sizeof(mask) / sizeof(*mask))) {
+        return false;
+    }
+    mask[(unsigned)cpu / bits] = 1UL << ((unsigned)cpu % bits);
+    return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+/* One idle round according to the stage's wait strategy, round counts idle calls in a row. */
+SPSC_PIPELINE_UTIL void spsc_pipeline_wait(struct spsc_pipeline_worker *worker, unsigned round) {
+    const unsigned long long sleep_ns = SPSC_PIPELINE_SLEEP_NS;
+
+#ifdef SPSC_FIFO_WAIT
+    if (worker->stage.wait == spsc_pipeline_wait_block && round >= SPSC_PIPELINE_SPIN_COUNT) {
+        /* Bounded slices, so a stop request reaching a first stage is still noticed. */
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += (long)sleep_ns;
+        if (deadline.tv_nsec >= (long)SPSC_PIPELINE_NS_IN_S) {
+            deadline.tv_sec  += 1;
+            deadline.tv_nsec -= (long)SPSC_PIPELINE_NS_IN_S;
+        }
+
+        if (worker->in != NULL && spsc_fifo_is_empty(worker->in)) {
+            spsc_fifo_wait_readable(worker->in, 1, &deadline);
+        } else if (worker->out != NULL && spsc_fifo_is_full(worker->out)) {
+            spsc_fifo_wait_writable(worker->out, 1, &deadline);
+        } else {
+            thrd_yield();
+        }
+        return;
+    }
+#endif
+
+    if (worker->stage.wait == spsc_pipeline_wait_spin || round < SPSC_PIPELINE_SPIN_COUNT) {
+        SPSC_PIPELINE_CPU_RELAX();
+    } else if (round < SPSC_PIPELINE_SPIN_COUNT + SPSC_PIPELINE_YIELD_COUNT) {
+        thrd_yield();
+    } else {
+        thrd_sleep(&(struct timespec) {.tv_sec = 0, .tv_nsec = (long)sleep_ns}, NULL);
+    }
+}
+
+/* The upstream side of a stage is finished once its input is closed and drained (or it has no input and the
+   pipeline is stopping), the downstream side once its consumer closed the output. */
+SPSC_PIPELINE_UTIL bool spsc_pipeline_finished(struct spsc_pipeline_worker *worker) {
+    if (worker->in == NULL ? SPSC_FIFO_ATOMIC_LOAD(&(worker->pipeline->stopping), SPSC_FIFO_MEMORY_ORDER_ACQUIRE)
+                           : spsc_fifo_is_eof(worker->in)) {
+        return true;
+    }
+    return worker->out != NULL && spsc_fifo_is_closed(worker->out);
+}
+
+SPSC_PIPELINE_UTIL int spsc_pipeline_run(void *arg) {
+    struct spsc_pipeline_worker *worker = arg;
+
+    if (worker->stage.cpu >= 0) {
+        SPSC_FIFO_ATOMIC_STORE(&(worker->pinned), spsc_pipeline_pin(worker->stage.cpu), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    }
+    if (worker->in != NULL) {
+        spsc_fifo_bind_consumer(worker->in);
+    }
+    if (worker->out != NULL) {
+        spsc_fifo_bind_producer(worker->out);
+    }
+
+    SPSC_FIFO_ATOMIC_STORE(&(worker->start_ns), spsc_pipeline_now_ns(), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    unsigned round = 0;
+    unsigned long long idle_since = 0;
+    while (true) {
+        const int status = worker->stage.fn(worker->in, worker->out, worker->stage.arg);
+        if (status == spsc_pipeline_done) {
+            break;
+        }
+
+        if (status == spsc_pipeline_progress) {
+            spsc_pipeline_count(&(worker->progress), 1);
+            if (round != 0) {
+                spsc_pipeline_count(&(worker->idle_ns), spsc_pipeline_now_ns() - idle_since);
+                round = 0;
+            }
+            continue;
+        }
+
+        spsc_pipeline_count(&(worker->idle), 1);
+        if (spsc_pipeline_finished(worker)) {
+            break;
+        }
+        if (round == 0) {
+            idle_since = spsc_pipeline_now_ns();
+        }
+        spsc_pipeline_wait(worker, round);
+        round += round < ~0U;
+    }
+
+    const unsigned long long end_ns = spsc_pipeline_now_ns();
+    if (round != 0) {
+        spsc_pipeline_count(&(worker->idle_ns), end_ns - idle_since);
+    }
+
+    if (worker->out != NULL) {
+        spsc_fifo_close_write(worker->out);
+    }
+    if (worker->in != NULL && !spsc_fifo_is_closed(worker->in)) {
+        spsc_fifo_close_read(worker->in);
+    }
+
+    SPSC_FIFO_ATOMIC_STORE(&(worker->end_ns), end_ns, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    return EXIT_SUCCESS;
+}
+
+SPSC_PIPELINE_IMPL int spsc_pipeline_alloc(spsc_pipeline **pipeline, const spsc_pipeline_stage *stages, unsigned count, spsc_fifo_usize fifo_capacity) {
+    if (count == 0 || count > 4096) {
+        return spsc_fifo_alloc_inval;
+    }
+
+    const size_t workers_offset = (size_t)(((sizeof(**pipeline) + _Alignof(struct spsc_pipeline_worker) - 1) / _Alignof(struct spsc_pipeline_worker)) * _Alignof(struct spsc_pipeline_worker));
+    const size_t fifos_offset   = workers_offset + count * sizeof(struct spsc_pipeline_worker);
+
+    void *mem = SPSC_FIFO_ALLOC(_Alignof(struct spsc_pipeline_worker) - 1 + fifos_offset + count * sizeof(spsc_fifo*));
+    if (mem == NULL) {
+        return spsc_fifo_alloc_nomem;
+    }
+
+    const uintptr_t alignment = _Alignof(struct spsc_pipeline_worker);
+    *pipeline = (spsc_pipeline*)(((uintptr_t)mem + alignment - 1) & ~(alignment - 1));
+    (*pipeline)->workers = (struct spsc_pipeline_worker*)((unsigned char*)(*pipeline) + workers_offset);
+    (*pipeline)->fifos   = (spsc_fifo**)((unsigned char*)(*pipeline) + fifos_offset);
+    (*pipeline)->mem     = mem;
+    (*pipeline)->count   = count;
+    SPSC_FIFO_ATOMIC_STORE(&((*pipeline)->stopping), false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    int status = spsc_fifo_alloc_success;
+    for (unsigned i = 0; i + 1 < count; ++i) {
+        (*pipeline)->fifos[i] = NULL;
+    }
+    for (unsigned i = 0; i + 1 < count && status == spsc_fifo_alloc_success; ++i) {
+        status = spsc_fifo_alloc(&((*pipeline)->fifos[i]), fifo_capacity);
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        struct spsc_pipeline_worker *worker = &((*pipeline)->workers[i]);
+        SPSC_FIFO_ATOMIC_STORE(&(worker->progress), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_STORE(&(worker->idle),     0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_STORE(&(worker->start_ns), 0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_STORE(&(worker->end_ns),   0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_STORE(&(worker->idle_ns),  0, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        SPSC_FIFO_ATOMIC_STORE(&(worker->pinned),   false, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+        worker->stage    = stages[i];
+        worker->in       = i > 0 ? (*pipeline)->fifos[i - 1] : NULL;
+        worker->out      = i + 1 < count ? (*pipeline)->fifos[i] : NULL;
+        worker->pipeline = *pipeline;
+        worker->started  = false;
+    }
+
+    if (status != spsc_fifo_alloc_success) {
+        spsc_pipeline_free(pipeline);
+    }
+
+    return status;
+}
+
+SPSC_PIPELINE_IMPL void spsc_pipeline_free(spsc_pipeline **pipeline) {
+    if (*pipeline == NULL) {
+        return;
+    }
+
+    for (unsigned i = 0; i + 1 < (*pipeline)->count; ++i) {
+        if ((*pipeline)->fifos[i] != NULL) {
+            spsc_fifo_free(&((*pipeline)->fifos[i]));
+        }
+    }
+
+    SPSC_FIFO_FREE((*pipeline)->mem);
+    *pipeline = NULL;
+}
+
+/* Stages start from the last one. If a thread cannot be created, the FIFO into the stages already running is
+   closed in its place so they drain and exit, and they are joined before returning false. */
+SPSC_PIPELINE_IMPL bool spsc_pipeline_start(spsc_pipeline *pipeline) {
+    for (unsigned i = pipeline->count; i-- > 0;) {
+        struct spsc_pipeline_worker *worker = &(pipeline->workers[i]);
+        if (thrd_create(&(worker->thrd), spsc_pipeline_run, worker) != thrd_success) {
+            if (worker->out != NULL) {
+                spsc_fifo_close_write(worker->out);
+            }
+            spsc_pipeline_join(pipeline);
+            return false;
+        }
+        worker->started = true;
+    }
+
+    return true;
+}
+
+SPSC_PIPELINE_IMPL void spsc_pipeline_stop(spsc_pipeline *pipeline) {
+    SPSC_FIFO_ATOMIC_STORE(&(pipeline->stopping), true, SPSC_FIFO_MEMORY_ORDER_RELEASE);
+}
+
+SPSC_PIPELINE_IMPL bool spsc_pipeline_join(spsc_pipeline *pipeline) {
+    bool ok = true;
+    for (unsigned i = 0; i < pipeline->count; ++i) {
+        struct spsc_pipeline_worker *worker = &(pipeline->workers[i]);
+        if (worker->started) {
+            ok = thrd_join(worker->thrd, NULL) == thrd_success && ok;
+            worker->started = false;
+        }
+    }
+
+    return ok;
+}
+
+SPSC_PIPELINE_IMPL void spsc_pipeline_stats(spsc_pipeline *pipeline, unsigned stage, spsc_pipeline_stage_stats *stats) {
+    struct spsc_pipeline_worker *worker = &(pipeline->workers[stage]);
+
+    const unsigned long long start_ns = SPSC_FIFO_ATOMIC_LOAD(&(worker->start_ns), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    const unsigned long long end_ns   = SPSC_FIFO_ATOMIC_LOAD(&(worker->end_ns),   SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    stats->progress = SPSC_FIFO_ATOMIC_LOAD(&(worker->progress), SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->idle     = SPSC_FIFO_ATOMIC_LOAD(&(worker->idle),     SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->idle_ns  = SPSC_FIFO_ATOMIC_LOAD(&(worker->idle_ns),  SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    stats->run_ns   = start_ns == 0 ? 0 : (end_ns != 0 ? end_ns : spsc_pipeline_now_ns()) - start_ns;
+    stats->pinned   = SPSC_FIFO_ATOMIC_LOAD(&(worker->pinned),   SPSC_FIFO_MEMORY_ORDER_RELAXED);
+
+    /* idle_ns only grows at the end of an idle streak, a stage idle right now may briefly look busier */
+    stats->utilization = stats->run_ns == 0 || stats->idle_ns >= stats->run_ns
+                       ? 0.0
+                       : 1.0 - (double)stats->idle_ns / (double)stats->run_ns;
+}
+
+#endif //SPSC_PIPELINE_IMPLEMENTATION
+
+/*
+   Copyright 2025 Karlo Bratko <kbratko@tuta.io>
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+   and associated documentation files (the “Software”), to deal in the Software without
+   restriction, including without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in all copies or
+   substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#ifdef CACHE_LINE_SIZE
+#define SPSC_FIFO_CACHE_LINE_SIZE CACHE_LINE_SIZE
+#endif
+
+#include "../spsc-fifo.hpp"
+
+/* Checks of spsc::typed_fifo, which is header-only and links nothing from the C implementation. Elements are
+   strings so a missed constructor or destructor shows up under a sanitizer as well as in the live count. */
+
+static int failures = 0;
+
+#define CHECK(expr)                                                                       \
+    do {                                                                                  \
+        if (!(expr)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+            ++failures;                                                                   \
+        }                                                                                 \
+    } while (0)
+
+struct counted {
+    static inline int live = 0;
+
+    std::string text;
+
+    explicit counted(int value) : text(std::to_string(value) + " with enough text to leave the small buffer") { ++live; }
+    counted(const counted& other) : text(other.text) { ++live; }
+    counted(counted&& other) noexcept : text(std::move(other.text)) { ++live; }
+    counted& operator=(const counted&) = default;
+    counted& operator=(counted&&) noexcept = default;
+    ~counted() { --live; }
+};
+
+static bool holds(const counted& element, int value) {
+    return element.text.starts_with(std::to_string(value) + " ");
+}
+
+static void test_typed_fifo() {
+    auto queue = std::make_unique<spsc::typed_fifo<counted, 8>>();
+
+    CHECK(queue->is_empty());
+    CHECK(queue->front() == nullptr);
+
+    /* Fill, drain half, refill so the readable elements wrap around the end of the slots. */
+    for (int i = 0; i < 8; ++i) {
+        CHECK(queue->try_emplace(i));
+    }
+    CHECK(queue->is_full());
+    CHECK(!queue->try_emplace(8));
+    CHECK(counted::live == 8);
+
+    for (int i = 0; i < 5; ++i) {
+        counted *element = queue->front();
+        CHECK(element != nullptr && holds(*element, i));
+        queue->pop();
+    }
+    CHECK(counted::live == 3);
+
+    for (int i = 8; i < 13; ++i) {
+        CHECK(queue->try_push(counted(i)));
+    }
+    CHECK(queue->is_full());
+    CHECK(counted::live == 8);
+
+    auto views = queue->readable();
+    CHECK(views[0].size() == 3 && views[1].size() == 5);
+    CHECK(holds(views[0][0], 5) && holds(views[1][0], 8) && holds(views[1][4], 12));
+
+    queue->consume(4);
+    CHECK(counted::live == 4);
+
+    counted out(-1);
+    CHECK(queue->try_pop(out) && holds(out, 9));
+    CHECK(counted::live == 4);
+
+    /* The remaining three are destroyed with the queue. */
+    queue.reset();
+    CHECK(counted::live == 1);
+}
+
+int main() {
+    test_typed_fifo();
+
+    if (failures != 0) {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1106 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef CACHE_LINE_SIZE
+#define SPSC_FIFO_CACHE_LINE_SIZE CACHE_LINE_SIZE
+#endif
+
+#define SPSC_FIFO_IMPLEMENTATION
+#include "../spsc-fifo.h"
+
+/* spsc-pipeline.h includes spsc-fifo.h again, whose implementation is already compiled in above. */
+#undef SPSC_FIFO_IMPLEMENTATION
+#define SPSC_PIPELINE_IMPLEMENTATION
+#include "../spsc-pipeline.h"
+
+/* Focused checks of each API, single-threaded unless blocking is the point, with extra checks for the options
+   the test is built with. Reaching into the FIFO's fields is fine here, the test compiles the implementation
+   itself. */
+
+#define FILE_PATH "spsc-fifo-test.dat"
+
+static int failures = 0;
+
+#define CHECK(expr)                                                                 \
+    do {                                                                            \
+        if (!(expr)) {                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+            ++failures;                                                             \
+        }                                                                           \
+    } while (0)
+
+static void fill(spsc_fifo_byte *buf, spsc_fifo_usize len, unsigned seed) {
+    for (spsc_fifo_usize i = 0; i < len; ++i) {
+        buf[i] = (spsc_fifo_byte)(seed + i * 7);
+    }
+}
+
+/* Byte stream: uneven chunks keep crossing the end of a small buffer. */
+static void test_wrap(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 16) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[16], out[16];
+    for (unsigned i = 0; i < 1000; ++i) {
+        const spsc_fifo_usize len = 1 + i % 11;
+        fill(in, len, i);
+        CHECK(spsc_fifo_write_n(fifo, in, len));
+        CHECK(spsc_fifo_read_avail(fifo) == len);
+        CHECK(spsc_fifo_read_n(fifo, out, len) && memcmp(in, out, len) == 0);
+    }
+
+    fill(in, 16, 0);
+    CHECK(spsc_fifo_write_n(fifo, in, 16));
+    CHECK(spsc_fifo_write_avail(fifo) == 0 && spsc_fifo_write(fifo, in, 1) == 0);
+    CHECK(spsc_fifo_read_n(fifo, out, 16) && memcmp(in, out, 16) == 0);
+    CHECK(spsc_fifo_is_empty(fifo));
+
+    spsc_fifo_free(&fifo);
+}
+
+/* Zero-copy: reserved and acquired space splits into two regions at the end of the buffer, contiguous requests
+   that would cross it are refused. */
+static void test_reserve_acquire(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[64], out[64];
+    spsc_fifo_region regions[2];
+    fill(in, sizeof(in), 4);
+
+    CHECK(spsc_fifo_write_n(fifo, in, 48) && spsc_fifo_skip_n(fifo, 48));
+
+    CHECK(spsc_fifo_write_reserve_contig(fifo, 17) == NULL);
+    CHECK(spsc_fifo_write_reserve(fifo, regions, 40) == 40);
+    CHECK(regions[0].len == 16 && regions[1].len == 24);
+    memcpy(regions[0].ptr, in, 16);
+    memcpy(regions[1].ptr, in + 16, 24);
+    CHECK(spsc_fifo_read_avail(fifo) == 0);
+    spsc_fifo_write_commit(fifo, 40);
+    CHECK(spsc_fifo_read_avail(fifo) == 40);
+
+    CHECK(spsc_fifo_read_acquire_contig(fifo, 17) == NULL);
+    const spsc_fifo_byte *contig = spsc_fifo_read_acquire_contig(fifo, 16);
+    CHECK(contig != NULL && memcmp(contig, in, 16) == 0);
+    CHECK(spsc_fifo_read_acquire(fifo, regions, 64) == 40);
+    CHECK(regions[0].len == 16 && regions[1].len == 24);
+    memcpy(out, regions[0].ptr, 16);
+    memcpy(out + 16, regions[1].ptr, 24);
+    CHECK(memcmp(in, out, 40) == 0);
+    spsc_fifo_read_release(fifo, 10);
+    CHECK(spsc_fifo_read_n(fifo, out, 30) && memcmp(in + 10, out, 30) == 0);
+
+    spsc_fifo_byte *slot = spsc_fifo_write_reserve_contig(fifo, 8);
+    CHECK(slot != NULL);
+    if (slot != NULL) {
+        memcpy(slot, in, 8);
+        spsc_fifo_write_commit(fifo, 8);
+    }
+    CHECK(spsc_fifo_read_n(fifo, out, 8) && memcmp(in, out, 8) == 0);
+
+    spsc_fifo_free(&fifo);
+}
+
+/* Mirrored buffer: contiguous spans may cross the end of the buffer and read back through the second mapping.
+   Without mirroring the same calls must still behave like a plain FIFO. */
+static void test_mirrored(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_mmap_alloc(&fifo, 4096) == spsc_fifo_alloc_success);
+
+    /* mirroring rounds the capacity up to the page size */
+    static spsc_fifo_byte in[1 << 16], out[1 << 16];
+    fill(in, sizeof(in), 6);
+    CHECK(fifo->capacity <= sizeof(in));
+    if (fifo->capacity > sizeof(in)) {
+        spsc_fifo_free(&fifo);
+        return;
+    }
+
+    const spsc_fifo_usize front = fifo->capacity - 16;
+    CHECK(spsc_fifo_write_n(fifo, in, front) && spsc_fifo_skip_n(fifo, front));
+
+    spsc_fifo_byte *slot = spsc_fifo_write_reserve_contig(fifo, 64);
+    CHECK((slot != NULL) == spsc_fifo_is_mirrored(fifo));
+    if (slot != NULL) {
+        memcpy(slot, in, 64);
+        spsc_fifo_write_commit(fifo, 64);
+        const spsc_fifo_byte *contig = spsc_fifo_read_acquire_contig(fifo, 64);
+        CHECK(contig != NULL && memcmp(contig, in, 64) == 0);
+        spsc_fifo_read_release(fifo, 16);
+    } else {
+        CHECK(spsc_fifo_write_n(fifo, in, 64) && spsc_fifo_skip_n(fifo, 16));
+    }
+    CHECK(spsc_fifo_read_n(fifo, out, 48) && memcmp(in + 16, out, 48) == 0);
+
+    CHECK(spsc_fifo_write_n(fifo, in, fifo->capacity));
+    CHECK(spsc_fifo_read_n(fifo, out, fifo->capacity) && memcmp(in, out, fifo->capacity) == 0);
+
+    spsc_fifo_free(&fifo);
+}
+
+/* Cached opposite counters: a stale but non-zero cache must not cut a transfer short. */
+static void test_stale_cache(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[64], out[64];
+    spsc_fifo_region regions[2];
+    fill(in, sizeof(in), 3);
+
+    CHECK(spsc_fifo_write(fifo, in, 60) == 60);
+    CHECK(spsc_fifo_read(fifo, out, 60) == 60);
+    CHECK(spsc_fifo_write(fifo, in, 10) == 10);
+    CHECK(spsc_fifo_read(fifo, out, 10) == 10 && memcmp(in, out, 10) == 0);
+
+    CHECK(spsc_fifo_write(fifo, in, 50) == 50);
+    CHECK(spsc_fifo_skip(fifo, 48) == 48);
+    CHECK(spsc_fifo_write_reserve(fifo, regions, 60) == 60);
+    spsc_fifo_write_commit(fifo, 60);
+    CHECK(spsc_fifo_peek(fifo, out, 62) == 62);
+    CHECK(spsc_fifo_read_acquire(fifo, regions, 62) == 62);
+    spsc_fifo_read_release(fifo, 62);
+    CHECK(spsc_fifo_is_empty(fifo));
+
+    spsc_fifo_free(&fifo);
+}
+
+/* Records in the default format: headers and payloads wrap like plain bytes, skipping and a full FIFO keep
+   the framing intact. */
+static void test_records(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    const spsc_fifo_usize header = SPSC_FIFO_RECORD_HEADER_SIZE;
+    spsc_fifo_byte in[64], out[64];
+    spsc_fifo_usize len;
+
+    CHECK(!spsc_fifo_pop_record(fifo, out, sizeof(out), &len));
+    CHECK(!spsc_fifo_push_record(fifo, in, 64 - header + 1));
+
+    for (unsigned i = 0; i < 100; ++i) {
+        const spsc_fifo_usize a = 1 + i % 13;
+        const spsc_fifo_usize b = 1 + i % 7;
+        fill(in, a, i);
+        CHECK(spsc_fifo_push_record(fifo, in, a));
+        CHECK(spsc_fifo_push_record(fifo, in, b));
+        CHECK(spsc_fifo_peek_record_len(fifo, &len) && len == a);
+        CHECK(spsc_fifo_pop_record(fifo, out, sizeof(out), &len) && len == a && memcmp(in, out, a) == 0);
+        CHECK(spsc_fifo_skip_record(fifo));
+        CHECK(!spsc_fifo_skip_record(fifo));
+    }
+
+    /* too small a destination leaves the record in place */
+    fill(in, 20, 1);
+    CHECK(spsc_fifo_push_record(fifo, in, 20));
+    CHECK(!spsc_fifo_pop_record(fifo, out, 19, &len));
+    CHECK(spsc_fifo_pop_record(fifo, out, 20, &len) && len == 20 && memcmp(in, out, 20) == 0);
+
+    while (spsc_fifo_push_record(fifo, in, 8)) {
+    }
+    CHECK(64 - spsc_fifo_read_avail(fifo) < header + 8);
+    CHECK(spsc_fifo_pop_record(fifo, out, sizeof(out), &len) && len == 8);
+
+    spsc_fifo_free(&fifo);
+}
+
+/* Contiguous records: padding in front of a record, and padding published alone when the record can never fit
+   behind it. Peeking must not move the consumer either way. */
+static void test_record_pad(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+    CHECK(spsc_fifo_set_record_format(fifo, SPSC_FIFO_RECORD_HEADER_SIZE, true));
+
+    const spsc_fifo_usize header = SPSC_FIFO_RECORD_HEADER_SIZE;
+    spsc_fifo_byte in[64], out[64];
+    spsc_fifo_usize len;
+
+    /* leaves 24 bytes before the end, too few for the next record */
+    const spsc_fifo_usize first = 40 - header;
+    fill(in, first, 1);
+    CHECK(spsc_fifo_push_record(fifo, in, first));
+    CHECK(spsc_fifo_pop_record(fifo, out, sizeof(out), &len) && len == first);
+
+    fill(in, first, 2);
+    CHECK(spsc_fifo_push_record(fifo, in, first));
+    spsc_fifo_usize read_shadow = fifo->read_shadow;
+    CHECK(spsc_fifo_peek_record_len(fifo, &len) && len == first);
+    CHECK(fifo->read_shadow == read_shadow);
+    CHECK(spsc_fifo_pop_record(fifo, out, sizeof(out), &len) && len == first && memcmp(in, out, len) == 0);
+    CHECK(fifo->read_shadow == read_shadow + 24 + 40);
+
+    /* 24 bytes of padding plus a 64 byte record exceed capacity: the padding goes out alone */
+    const spsc_fifo_usize whole = 64 - header;
+    fill(in, whole, 3);
+    CHECK(!spsc_fifo_push_record(fifo, in, whole));
+    read_shadow = fifo->read_shadow;
+    CHECK(!spsc_fifo_peek_record_len(fifo, &len));
+    CHECK(fifo->read_shadow == read_shadow);
+    CHECK(!spsc_fifo_pop_record(fifo, out, sizeof(out), &len));
+    CHECK(fifo->read_shadow == read_shadow + 24);
+
+    CHECK(spsc_fifo_push_record(fifo, in, whole));
+    CHECK(spsc_fifo_pop_record(fifo, out, sizeof(out), &len) && len == whole && memcmp(in, out, len) == 0);
+    CHECK(!spsc_fifo_pop_record(fifo, out, sizeof(out), &len));
+
+    spsc_fifo_free(&fifo);
+}
+
+/* Lossy records: a consumer lapped within capacity, and one left more than half the counter range behind. */
+static void test_lossy_lap(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 256) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[32], out[32];
+    spsc_fifo_usize len;
+    unsigned long long lost;
+
+    for (unsigned i = 0; i < 4; ++i) {
+        fill(in, sizeof(in), i);
+        CHECK(spsc_fifo_push_lossy(fifo, in, sizeof(in)));
+    }
+    CHECK(spsc_fifo_pop_lossy(fifo, out, sizeof(out), &len, &lost) && len == sizeof(in) && lost == 0);
+
+    /* 100 more records lap the consumer many times over */
+    for (unsigned i = 4; i < 104; ++i) {
+        fill(in, sizeof(in), i);
+        CHECK(spsc_fifo_push_lossy(fifo, in, sizeof(in)));
+    }
+
+    unsigned long long seen = 1;
+    unsigned long long skipped = 0;
+    CHECK(spsc_fifo_pop_lossy(fifo, out, sizeof(out), &len, &lost) && lost > 0);
+    skipped += lost;
+    ++seen;
+    while (spsc_fifo_pop_lossy(fifo, out, sizeof(out), &len, &lost)) {
+        CHECK(lost == 0);
+        ++seen;
+    }
+    fill(in, sizeof(in), 103);
+    CHECK(memcmp(in, out, sizeof(out)) == 0);
+    CHECK(seen + skipped == 104);
+
+    unsigned long long records, bytes;
+    spsc_fifo_lossy_lost(fifo, &records, &bytes);
+    CHECK(records == skipped && bytes != 0);
+
+    /* consumer far behind: resumes at the oldest record instead of spinning */
+    for (unsigned i = 104; i < 110; ++i) {
+        fill(in, sizeof(in), i);
+        CHECK(spsc_fifo_push_lossy(fifo, in, sizeof(in)));
+    }
+    fifo->read_shadow = fifo->write_shadow - (((spsc_fifo_usize)-1 >> 1) + 4096);
+    CHECK(spsc_fifo_pop_lossy(fifo, out, sizeof(out), &len, &lost) && len == sizeof(in));
+    CHECK(fifo->write_shadow - fifo->read_shadow <= fifo->capacity);
+    while (spsc_fifo_pop_lossy(fifo, out, sizeof(out), &len, &lost)) {
+    }
+    fill(in, sizeof(in), 109);
+    CHECK(memcmp(in, out, sizeof(out)) == 0);
+
+    spsc_fifo_free(&fifo);
+}
+
+/* Segmented FIFO: grows past one segment, stops at the hard cap, keeps order across segments and doesn't grow
+   while the tail has room. */
+static void test_segments(void) {
+    spsc_fifo_seg *seg;
+    CHECK(spsc_fifo_seg_alloc(&seg, 1024, 2048, 4096) == spsc_fifo_alloc_success);
+
+    static spsc_fifo_byte in[4096], out[4096];
+    fill(in, sizeof(in), 5);
+
+    CHECK(spsc_fifo_seg_write_n(seg, in, 3000));
+    CHECK(spsc_fifo_seg_memory(seg) >= 3000 && spsc_fifo_seg_read_avail(seg) == 3000);
+    CHECK(!spsc_fifo_seg_write_n(seg, in + 3000, 1096 + 1));
+    CHECK(spsc_fifo_seg_write(seg, in + 3000, 2000) == 1096);
+
+    CHECK(spsc_fifo_seg_read_n(seg, out, 4096) && memcmp(in, out, 4096) == 0);
+    CHECK(spsc_fifo_seg_read_avail(seg) == 0);
+    CHECK(spsc_fifo_seg_memory(seg) <= 2048);
+
+    CHECK(spsc_fifo_seg_write_n(seg, in, 1500));
+    CHECK(spsc_fifo_seg_read(seg, out, sizeof(out)) == 1500 && memcmp(in, out, 1500) == 0);
+
+    spsc_fifo_seg_free(&seg);
+
+    /* A segment drained behind the producer's back is reused rather than followed by a second one. */
+    CHECK(spsc_fifo_seg_alloc(&seg, 1024, 0, 0) == spsc_fifo_alloc_success);
+    const spsc_fifo_usize one_segment = spsc_fifo_seg_memory(seg);
+
+    CHECK(spsc_fifo_seg_write(seg, in, 1024) == 1024);
+    CHECK(spsc_fifo_seg_read(seg, out, 1024) == 1024);
+    CHECK(spsc_fifo_seg_write(seg, in, 1000) == 1000);
+    CHECK(spsc_fifo_seg_write_n(seg, in + 1000, 24));
+    CHECK(seg->head == seg->tail && spsc_fifo_seg_memory(seg) == one_segment);
+    CHECK(spsc_fifo_seg_read_n(seg, out, 1024) && memcmp(in, out, 1024) == 0);
+
+    spsc_fifo_seg_free(&seg);
+}
+
+/* Batched publication: positions become visible every batch bytes, on flush, or when the side running short
+   publishes what it has pending. */
+static void test_batch(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[64], out[64];
+    fill(in, sizeof(in), 8);
+
+    spsc_fifo_set_write_batch(fifo, 32);
+    for (unsigned i = 0; i < 3; ++i) {
+        CHECK(spsc_fifo_write_n(fifo, in + i * 8, 8));
+    }
+    CHECK(spsc_fifo_read_avail(fifo) == 0);
+    CHECK(spsc_fifo_write_n(fifo, in + 24, 8));
+    CHECK(spsc_fifo_read_avail(fifo) == 32);
+    CHECK(spsc_fifo_write_n(fifo, in + 32, 8));
+    CHECK(spsc_fifo_read_avail(fifo) == 32);
+    spsc_fifo_flush_write(fifo);
+    CHECK(spsc_fifo_read_avail(fifo) == 40);
+
+    spsc_fifo_set_read_batch(fifo, 32);
+    CHECK(spsc_fifo_read_n(fifo, out, 8));
+    CHECK(spsc_fifo_write_avail(fifo) == 24);
+    CHECK(spsc_fifo_read_n(fifo, out + 8, 24));
+    CHECK(spsc_fifo_write_avail(fifo) == 56);
+    CHECK(spsc_fifo_read_n(fifo, out + 32, 8) && memcmp(in, out, 40) == 0);
+    CHECK(spsc_fifo_write_avail(fifo) == 56);
+
+    /* a consumer short of data publishes its pending reads, a producer short of space its pending writes */
+    CHECK(!spsc_fifo_read_n(fifo, out, 1));
+    CHECK(spsc_fifo_write_avail(fifo) == 64);
+    CHECK(spsc_fifo_write_n(fifo, in, 24) && spsc_fifo_read_avail(fifo) == 0);
+    CHECK(!spsc_fifo_write_n(fifo, in, 41));
+    CHECK(spsc_fifo_read_avail(fifo) == 24);
+    CHECK(spsc_fifo_read(fifo, out, sizeof(out)) == 24 && memcmp(in, out, 24) == 0);
+
+    spsc_fifo_free(&fifo);
+}
+
+typedef struct test_item {
+    double value;
+    unsigned seq;
+    char tag;
+} test_item;
+
+SPSC_FIFO_DEFINE_TYPED(test_queue, test_item);
+
+/* Typed queue: capacity in elements, aligned slots, full/empty at the element boundary and order across wraps. */
+static void test_typed(void) {
+    test_queue *queue;
+    CHECK(test_queue_alloc(&queue, 5) == spsc_fifo_alloc_success);
+    CHECK(queue->capacity == 8);
+    CHECK((uintptr_t)queue->slots % _Alignof(test_item) == 0);
+
+    CHECK(test_queue_is_empty(queue) && test_queue_front(queue) == NULL);
+    for (unsigned i = 0; i < 8; ++i) {
+        const test_item item = { i * 0.5, i, 'a' };
+        CHECK(test_queue_push(queue, &item));
+    }
+    CHECK(test_queue_is_full(queue) && test_queue_emplace(queue) == NULL);
+
+    unsigned next = 0;
+    for (unsigned i = 8; i < 100; ++i) {
+        test_item *front = test_queue_front(queue);
+        CHECK(front != NULL && front->seq == next && front->value == next * 0.5);
+        test_queue_pop(queue);
+        ++next;
+
+        test_item *slot = test_queue_emplace(queue);
+        CHECK(slot != NULL);
+        if (slot != NULL) {
+            slot->value = i * 0.5;
+            slot->seq   = i;
+            slot->tag   = 'b';
+            test_queue_commit(queue);
+        }
+    }
+    while (!test_queue_is_empty(queue)) {
+        CHECK(test_queue_front(queue)->seq == next);
+        test_queue_pop(queue);
+        ++next;
+    }
+    CHECK(next == 100);
+
+    test_queue_free(&queue);
+    CHECK(queue == NULL);
+}
+
+SPSC_FIFO_DEFINE_STATIC(test_static, 64);
+
+static test_static static_fifo;
+
+/* Static FIFO: zeroed storage is usable as is, transfers wrap, and a stale cache doesn't shorten a write. */
+static void test_static_fifo(void) {
+    spsc_fifo_byte in[64], out[64];
+    fill(in, sizeof(in), 7);
+
+    CHECK(test_static_read_avail(&static_fifo) == 0 && test_static_write_avail(&static_fifo) == 64);
+    CHECK(test_static_write(&static_fifo, in, 60) == 60);
+    CHECK(test_static_read(&static_fifo, out, 60) == 60 && memcmp(in, out, 60) == 0);
+    CHECK(test_static_write(&static_fifo, in, 10) == 10);
+    CHECK(test_static_read(&static_fifo, out, 64) == 10 && memcmp(in, out, 10) == 0);
+
+    CHECK(test_static_write_n(&static_fifo, in, 64) && !test_static_write_n(&static_fifo, in, 1));
+    CHECK(test_static_write(&static_fifo, in, 1) == 0);
+    CHECK(test_static_peek_n(&static_fifo, out, 64) && memcmp(in, out, 64) == 0);
+    CHECK(test_static_skip_n(&static_fifo, 14));
+    CHECK(test_static_read_n(&static_fifo, out, 50) && memcmp(in + 14, out, 50) == 0);
+    CHECK(!test_static_read_n(&static_fifo, out, 1) && test_static_read(&static_fifo, out, 1) == 0);
+
+    test_static local;
+    test_static_init(&local);
+    CHECK(test_static_write_n(&local, in, 33) && test_static_read_avail(&local) == 33);
+}
+
+#ifndef SPSC_FIFO_NO_SHM
+#define SHM_NAME "/spsc-fifo-test"
+
+/* Shared memory: a second mapping of the same object, at another address, sees the same FIFO. */
+static void test_shm(void) {
+    spsc_fifo_shm_unlink(SHM_NAME);
+
+    spsc_fifo *producer = NULL, *consumer = NULL, *again = NULL;
+    CHECK(spsc_fifo_shm_create(&producer, SHM_NAME, 100) == spsc_fifo_alloc_success);
+    CHECK(spsc_fifo_shm_create(&again, SHM_NAME, 100) != spsc_fifo_alloc_success);
+    CHECK(spsc_fifo_shm_attach(&consumer, SHM_NAME) == spsc_fifo_alloc_success);
+    CHECK(spsc_fifo_shm_unlink(SHM_NAME));
+    if (producer == NULL || consumer == NULL) {
+        spsc_fifo_free(&producer);
+        spsc_fifo_free(&consumer);
+        return;
+    }
+    CHECK(producer != consumer && consumer->capacity == 128);
+
+    spsc_fifo_group *group;
+    CHECK(spsc_fifo_group_alloc(&group, 1) == spsc_fifo_alloc_success);
+    CHECK(!spsc_fifo_group_add(group, producer));
+    spsc_fifo_group_free(&group);
+
+    spsc_fifo_byte in[100], out[100];
+    for (unsigned i = 0; i < 50; ++i) {
+        fill(in, sizeof(in), i);
+        CHECK(spsc_fifo_write_n(producer, in, sizeof(in)));
+        CHECK(spsc_fifo_read_n(consumer, out, sizeof(out)) && memcmp(in, out, sizeof(out)) == 0);
+    }
+    CHECK(spsc_fifo_is_empty(consumer) && spsc_fifo_write_avail(producer) == 128);
+
+    spsc_fifo_free(&consumer);
+    spsc_fifo_free(&producer);
+}
+#endif
+
+#ifdef SPSC_FIFO_STATS
+/* Statistics: each counter moves once for the operation it describes, and only then. */
+static void test_stats(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[64], out[64];
+    spsc_fifo_stats stats;
+    fill(in, sizeof(in), 11);
+
+    CHECK(spsc_fifo_write(fifo, in, 60) == 60 && spsc_fifo_read(fifo, out, 60) == 60);
+    CHECK(spsc_fifo_write(fifo, in, 10) == 10);
+    spsc_fifo_stats_snapshot(fifo, &stats);
+    CHECK(stats.writes == 2 && stats.bytes_written == 70 && stats.write_splits == 1);
+    CHECK(stats.partial_writes == 0 && stats.write_full == 0);
+
+    CHECK(spsc_fifo_write(fifo, in, 64) == 54 && spsc_fifo_write(fifo, in, 1) == 0);
+    spsc_fifo_stats_snapshot(fifo, &stats);
+    CHECK(stats.partial_writes == 1 && stats.write_full == 1 && stats.high_water == 64);
+
+    CHECK(spsc_fifo_read(fifo, out, 64) == 64 && spsc_fifo_read(fifo, out, 1) == 0);
+    spsc_fifo_stats_snapshot(fifo, &stats);
+    CHECK(stats.reads == 2 && stats.bytes_read == 124 && stats.read_splits == 1);
+    CHECK(stats.partial_reads == 0 && stats.read_empty == 1);
+
+    spsc_fifo_free(&fifo);
+}
+#endif
+
+#ifdef SPSC_FIFO_TRACE
+/* Tracing: a sample completes when the last byte of its publish is read, stamps past the queue are dropped, and
+   buckets grow log-linearly. */
+static void test_trace(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 1024) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[8], out[1024];
+    spsc_fifo_trace trace;
+    fill(in, sizeof(in), 13);
+
+    spsc_fifo_set_trace_rate(fifo, 2);
+    for (int i = 0; i < 4; ++i) {
+        CHECK(spsc_fifo_write_n(fifo, in, sizeof(in)));
+    }
+    CHECK(spsc_fifo_read(fifo, out, 10) == 10);
+    spsc_fifo_trace_snapshot(fifo, &trace);
+    CHECK(trace.samples == 0);
+    CHECK(spsc_fifo_read(fifo, out, 6) == 6);
+    spsc_fifo_trace_snapshot(fifo, &trace);
+    CHECK(trace.samples == 1);
+    CHECK(spsc_fifo_read(fifo, out, 16) == 16);
+    spsc_fifo_trace_snapshot(fifo, &trace);
+    CHECK(trace.samples == 2 && trace.dropped == 0);
+    CHECK(spsc_fifo_trace_percentile(&trace, 0.0) <= spsc_fifo_trace_percentile(&trace, 1.0));
+
+    /* Stamping every write queues 64 stamps, the rest are dropped until the consumer catches up. */
+    spsc_fifo_set_trace_rate(fifo, 1);
+    for (int i = 0; i < 100; ++i) {
+        CHECK(spsc_fifo_write_n(fifo, in, sizeof(in)));
+    }
+    CHECK(spsc_fifo_read(fifo, out, sizeof(out)) == 800);
+    spsc_fifo_trace_snapshot(fifo, &trace);
+    CHECK(trace.samples == 2 + 64 && trace.dropped == 100 - 64);
+
+    spsc_fifo_set_trace_rate(fifo, 0);
+    CHECK(spsc_fifo_write_n(fifo, in, sizeof(in)) && spsc_fifo_read(fifo, out, sizeof(out)) == sizeof(in));
+    spsc_fifo_trace_snapshot(fifo, &trace);
+    CHECK(trace.samples == 2 + 64);
+
+    CHECK(spsc_fifo_trace_bucket_min(7) == 7 && spsc_fifo_trace_bucket_min(8) == 8);
+    CHECK(spsc_fifo_trace_bucket_min(16) == 16 && spsc_fifo_trace_bucket_min(17) == 18);
+
+    spsc_fifo_free(&fifo);
+}
+#endif
+
+/* Counter width: positions keep working across the wrap of spsc_fifo_usize, and capacities the counters or the
+   address space can't hold are refused. */
+static void test_counter_width(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    const spsc_fifo_usize start = (spsc_fifo_usize)-100;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), start, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->read_count), start, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    fifo->write_shadow = fifo->read_count_cache = start;
+    fifo->read_shadow = fifo->write_count_cache = start;
+
+    spsc_fifo_byte in[64], out[64];
+    for (unsigned i = 0; i < 10; ++i) {
+        fill(in, 37, i);
+        CHECK(spsc_fifo_write_n(fifo, in, 37) && spsc_fifo_read_avail(fifo) == 37);
+        CHECK(spsc_fifo_read_n(fifo, out, 37) && memcmp(in, out, 37) == 0);
+    }
+    CHECK(fifo->read_shadow == start + 370 && spsc_fifo_write_avail(fifo) == 64);
+    spsc_fifo_free(&fifo);
+
+    const spsc_fifo_usize max_capacity = ((spsc_fifo_usize)-1 >> 1) + 1;
+    CHECK(spsc_fifo_alloc(&fifo, max_capacity + 1) == spsc_fifo_alloc_inval);
+    CHECK(spsc_fifo_alloc(&fifo, (spsc_fifo_usize)-1) == spsc_fifo_alloc_inval);
+}
+
+/* Allocation options: only requested options are reported applied, the buffer honors the alignment and the
+   FIFO works like any other. */
+static void test_alloc_ex(void) {
+    spsc_fifo *fifo;
+    spsc_fifo_alloc_options options = { 3, 0, -1 };
+    CHECK(spsc_fifo_alloc_ex(&fifo, 64, &options) == spsc_fifo_alloc_inval);
+
+    options.buf_alignment = 4096;
+    options.flags = spsc_fifo_alloc_flag_hugetlb | spsc_fifo_alloc_flag_thp | spsc_fifo_alloc_flag_prefault;
+    CHECK(spsc_fifo_alloc_ex(&fifo, 5000, &options) == spsc_fifo_alloc_success);
+    CHECK(fifo->capacity == 8192);
+    CHECK((uintptr_t)spsc_fifo_buf(fifo) % 4096 == 0);
+
+    const unsigned applied = spsc_fifo_alloc_flags(fifo);
+    CHECK((applied & ~options.flags) == 0);
+#ifdef SPSC_FIFO_MAPPED_BUF
+    CHECK(applied & spsc_fifo_alloc_flag_prefault);
+#endif
+
+    static spsc_fifo_byte in[8192], out[8192];
+    fill(in, sizeof(in), 13);
+    CHECK(spsc_fifo_write_n(fifo, in, 5000) && spsc_fifo_read_n(fifo, out, 5000) && memcmp(in, out, 5000) == 0);
+    CHECK(spsc_fifo_write_n(fifo, in, 8192) && spsc_fifo_read_n(fifo, out, 8192) && memcmp(in, out, 8192) == 0);
+
+    spsc_fifo_free(&fifo);
+}
+
+/* Copies: every small size at shifting offsets, and large writes that take the streaming path, both unaligned
+   and across the end of the buffer. */
+static void test_copy_sizes(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 1 << 18) == spsc_fifo_alloc_success);
+
+    static spsc_fifo_byte in[(1 << 17) + 8], out[(1 << 17) + 8];
+    fill(in, sizeof(in), 14);
+
+    for (spsc_fifo_usize len = 1; len <= 300; ++len) {
+        CHECK(spsc_fifo_write_n(fifo, in + len % 7, len));
+        CHECK(spsc_fifo_read_n(fifo, out + len % 5, len) && memcmp(in + len % 7, out + len % 5, len) == 0);
+    }
+
+    for (unsigned i = 0; i < 5; ++i) {
+        const spsc_fifo_usize len = (1 << 17) + i % 4;
+        memset(out, 0, sizeof(out));
+        CHECK(spsc_fifo_write_n(fifo, in + i % 3, len));
+        CHECK(spsc_fifo_read_n(fifo, out, len) && memcmp(in + i % 3, out, len) == 0);
+    }
+
+    spsc_fifo_free(&fifo);
+}
+
+/* File descriptors: transfers split at the end of the buffer, stop at the requested amount, and report a pipe
+   that is not ready or closed. */
+static void test_fd_io(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    CHECK(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0 && fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+
+    spsc_fifo_byte in[100], out[100];
+    spsc_fifo_usize transferred;
+    fill(in, sizeof(in), 15);
+
+    CHECK(spsc_fifo_write_n(fifo, in, 48) && spsc_fifo_skip_n(fifo, 48));
+    CHECK(spsc_fifo_write_from_fd(fifo, fds[0], 64, &transferred) == spsc_fifo_io_again && transferred == 0);
+
+    CHECK(write(fds[1], in, 100) == 100);
+    CHECK(spsc_fifo_write_from_fd(fifo, fds[0], 40, &transferred) == spsc_fifo_io_success && transferred == 40);
+    CHECK(spsc_fifo_write_from_fd(fifo, fds[0], 64, &transferred) == spsc_fifo_io_success && transferred == 24);
+    CHECK(spsc_fifo_write_from_fd(fifo, fds[0], 64, &transferred) == spsc_fifo_io_success && transferred == 0);
+
+    CHECK(spsc_fifo_read_to_fd(fifo, fds[1], 30, &transferred) == spsc_fifo_io_success && transferred == 30);
+    CHECK(spsc_fifo_read_to_fd(fifo, fds[1], 100, &transferred) == spsc_fifo_io_success && transferred == 34);
+    CHECK(spsc_fifo_is_empty(fifo));
+    /* the 36 bytes left in the pipe come out ahead of the 64 that went round through the FIFO */
+    CHECK(read(fds[0], out, sizeof(out)) == 100 && memcmp(in + 64, out, 36) == 0 && memcmp(in, out + 36, 64) == 0);
+
+    close(fds[1]);
+    CHECK(spsc_fifo_write_from_fd(fifo, fds[0], 64, &transferred) == spsc_fifo_io_eof && transferred == 0);
+    close(fds[0]);
+
+    spsc_fifo_free(&fifo);
+}
+
+#define GROUP_MEMBERS 70
+
+/* Fan-in group: members in more than one bitmap word are visited round-robin, an empty member drops out until
+   its producer publishes again. */
+static void test_group(void) {
+    spsc_fifo_group *group;
+    CHECK(spsc_fifo_group_alloc(&group, GROUP_MEMBERS) == spsc_fifo_alloc_success);
+
+    spsc_fifo *fifos[GROUP_MEMBERS + 1];
+    for (unsigned i = 0; i <= GROUP_MEMBERS; ++i) {
+        CHECK(spsc_fifo_alloc(&fifos[i], 16) == spsc_fifo_alloc_success);
+    }
+    for (unsigned i = 0; i < GROUP_MEMBERS; ++i) {
+        CHECK(spsc_fifo_group_add(group, fifos[i]));
+    }
+    CHECK(!spsc_fifo_group_add(group, fifos[GROUP_MEMBERS]));
+    CHECK(spsc_fifo_group_next_ready(group) == NULL);
+
+    spsc_fifo_byte byte = 1;
+    CHECK(spsc_fifo_write_n(fifos[65], &byte, 1) && spsc_fifo_write_n(fifos[3], &byte, 1));
+    CHECK(spsc_fifo_group_next_ready(group) == fifos[3]);
+    CHECK(spsc_fifo_group_next_ready(group) == fifos[65]);
+    CHECK(spsc_fifo_group_next_ready(group) == fifos[3]);
+    CHECK(spsc_fifo_read_n(fifos[3], &byte, 1) && spsc_fifo_read_n(fifos[65], &byte, 1));
+    CHECK(spsc_fifo_group_next_ready(group) == NULL);
+
+    CHECK(spsc_fifo_write_n(fifos[69], &byte, 1));
+    CHECK(spsc_fifo_group_next_ready(group) == fifos[69]);
+    CHECK(spsc_fifo_read_n(fifos[69], &byte, 1));
+    CHECK(spsc_fifo_group_next_ready(group) == NULL);
+
+    spsc_fifo_group_free(&group);
+    for (unsigned i = 0; i <= GROUP_MEMBERS; ++i) {
+        spsc_fifo_free(&fifos[i]);
+    }
+}
+
+/* Broadcast: every consumer sees every byte, the slowest one holds back the producer, and stale caches on
+   either side don't cut transfers short. */
+static void test_bcast(void) {
+    spsc_fifo_bcast *bcast;
+    CHECK(spsc_fifo_bcast_alloc(&bcast, 64, 0) == spsc_fifo_alloc_inval);
+    CHECK(spsc_fifo_bcast_alloc(&bcast, 64, 3) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[64], out[64];
+    fill(in, sizeof(in), 17);
+
+    CHECK(spsc_fifo_bcast_write(bcast, in, 60) == 60);
+    for (unsigned c = 0; c < 3; ++c) {
+        CHECK(spsc_fifo_bcast_read(bcast, c, out, 60) == 60 && memcmp(in, out, 60) == 0);
+    }
+    CHECK(spsc_fifo_bcast_write(bcast, in, 10) == 10);
+
+    CHECK(spsc_fifo_bcast_read(bcast, 0, out, 4) == 4);
+    CHECK(spsc_fifo_bcast_write(bcast, in + 10, 20) == 20);
+    CHECK(spsc_fifo_bcast_read(bcast, 0, out + 4, 26) == 26 && memcmp(in, out, 30) == 0);
+    CHECK(spsc_fifo_bcast_peek(bcast, 1, out, 30) == 30 && memcmp(in, out, 30) == 0);
+    CHECK(spsc_fifo_bcast_skip(bcast, 1, 30) == 30 && spsc_fifo_bcast_read_avail(bcast, 1) == 0);
+
+    /* consumer 2 still holds all 30 bytes */
+    CHECK(spsc_fifo_bcast_write_avail(bcast) == 34);
+    CHECK(!spsc_fifo_bcast_write_n(bcast, in, 35) && spsc_fifo_bcast_write(bcast, in, 64) == 34);
+    CHECK(spsc_fifo_bcast_read_n(bcast, 2, out, 30) && memcmp(in, out, 30) == 0);
+    CHECK(spsc_fifo_bcast_write_n(bcast, in, 30));
+    CHECK(spsc_fifo_bcast_skip_n(bcast, 2, 34) && spsc_fifo_bcast_peek_n(bcast, 2, out, 30) && memcmp(in, out, 30) == 0);
+    CHECK(spsc_fifo_bcast_read_avail(bcast, 0) == 64);
+
+#ifdef SPSC_FIFO_TRACE
+    spsc_fifo_trace trace;
+    spsc_fifo_trace_snapshot(bcast->ring, &trace);
+    CHECK(trace.samples == 0 && trace.dropped == 0);
+#endif
+
+    spsc_fifo_bcast_free(&bcast);
+    CHECK(bcast == NULL);
+}
+
+/* Closing: the consumer drains what was written before the producer closed, then sees end of stream. */
+static void test_close(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[16], out[16];
+    fill(in, sizeof(in), 18);
+    spsc_fifo_set_write_batch(fifo, 64);
+    CHECK(spsc_fifo_write_n(fifo, in, 16) && !spsc_fifo_is_closed(fifo));
+    spsc_fifo_close_write(fifo);
+    CHECK(spsc_fifo_is_closed(fifo) && !spsc_fifo_is_eof(fifo));
+    CHECK(spsc_fifo_read_n(fifo, out, 16) && memcmp(in, out, 16) == 0);
+    CHECK(spsc_fifo_is_eof(fifo));
+
+    spsc_fifo_reset(fifo);
+    CHECK(!spsc_fifo_is_closed(fifo));
+    spsc_fifo_close_read(fifo);
+    CHECK(spsc_fifo_is_closed(fifo) && spsc_fifo_is_eof(fifo));
+
+    spsc_fifo_free(&fifo);
+}
+
+#define PIPELINE_VALUES 20000u
+
+struct pipeline_source {
+    unsigned next;
+    unsigned limit; /* 0 for an endless stream */
+};
+
+struct pipeline_sink {
+    unsigned expected;
+    unsigned out_of_order;
+};
+
+static int pipeline_generate(spsc_fifo *in, spsc_fifo *out, void *arg) {
+    SPSC_FIFO_IGNORE(in);
+    struct pipeline_source *source = arg;
+
+    if (source->limit != 0 && source->next == source->limit) {
+        return spsc_pipeline_done;
+    }
+    if (!spsc_fifo_write_obj(out, &(source->next))) {
+        return spsc_pipeline_idle;
+    }
+    ++source->next;
+    return spsc_pipeline_progress;
+}
+
+static int pipeline_forward(spsc_fifo *in, spsc_fifo *out, void *arg) {
+    SPSC_FIFO_IGNORE(arg);
+    unsigned value;
+
+    if (spsc_fifo_write_avail(out) < sizeof(value) || !spsc_fifo_read_obj(in, &value)) {
+        return spsc_pipeline_idle;
+    }
+    spsc_fifo_write_obj(out, &value);
+    return spsc_pipeline_progress;
+}
+
+static int pipeline_check(spsc_fifo *in, spsc_fifo *out, void *arg) {
+    SPSC_FIFO_IGNORE(out);
+    struct pipeline_sink *sink = arg;
+    unsigned value;
+
+    if (!spsc_fifo_read_obj(in, &value)) {
+        return spsc_pipeline_idle;
+    }
+    sink->out_of_order += value != sink->expected;
+    sink->expected = value + 1;
+    return spsc_pipeline_progress;
+}
+
+/* Pipeline: a finite stream arrives whole and in order through every wait strategy, an endless one ends on stop. */
+static void test_pipeline(void) {
+    struct pipeline_source source = { 0, PIPELINE_VALUES };
+    struct pipeline_sink sink = { 0, 0 };
+    const spsc_pipeline_stage stages[] = {
+        { pipeline_generate, &source, -1, spsc_pipeline_wait_spin },
+        { pipeline_forward,  NULL,    -1, spsc_pipeline_wait_backoff },
+        { pipeline_check,    &sink,   -1, spsc_pipeline_wait_block },
+    };
+
+    spsc_pipeline *pipeline;
+    CHECK(spsc_pipeline_alloc(&pipeline, stages, 3, 4096) == spsc_fifo_alloc_success);
+    CHECK(spsc_pipeline_start(pipeline) && spsc_pipeline_join(pipeline));
+    CHECK(sink.expected == PIPELINE_VALUES && sink.out_of_order == 0);
+
+    spsc_pipeline_stage_stats stats;
+    spsc_pipeline_stats(pipeline, 2, &stats);
+    CHECK(stats.progress == PIPELINE_VALUES);
+    spsc_pipeline_free(&pipeline);
+
+    source.next  = 0;
+    source.limit = 0;
+    sink.expected = 0;
+    CHECK(spsc_pipeline_alloc(&pipeline, stages, 3, 4096) == spsc_fifo_alloc_success);
+    CHECK(spsc_pipeline_start(pipeline));
+    do {
+        thrd_yield();
+        spsc_pipeline_stats(pipeline, 2, &stats);
+    } while (stats.progress < 1000);
+    spsc_pipeline_stop(pipeline);
+    CHECK(spsc_pipeline_join(pipeline));
+    CHECK(sink.expected == source.next && sink.out_of_order == 0);
+    spsc_pipeline_free(&pipeline);
+}
+
+/* A three-part message goes in across the wrap as one publication, or not at all, and scatters back out. */
+static void test_iovec(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+
+    spsc_fifo_byte in[64], out[64];
+    fill(in, sizeof(in), 19);
+
+    CHECK(spsc_fifo_write_n(fifo, in, 40));
+    CHECK(spsc_fifo_skip_n(fifo, 40));
+
+    const struct iovec message[3] = {{in, 4}, {in + 4, 30}, {in + 34, 4}};
+    CHECK(spsc_fifo_writev_n(fifo, message, 3));
+    CHECK(spsc_fifo_read_avail(fifo) == 38);
+
+    const struct iovec too_long[2] = {{in, 20}, {in, 7}};
+    CHECK(!spsc_fifo_writev_n(fifo, too_long, 2));
+    CHECK(spsc_fifo_read_avail(fifo) == 38);
+
+    memset(out, 0, sizeof(out));
+    const struct iovec parts[3] = {{out, 10}, {out + 10, 20}, {out + 30, 34}};
+    CHECK(!spsc_fifo_readv_n(fifo, parts, 3));
+    CHECK(spsc_fifo_readv(fifo, parts, 3) == 38 && memcmp(in, out, 38) == 0);
+    CHECK(spsc_fifo_is_empty(fifo));
+
+    /* The consumer's copy of write_count is 10 bytes behind when the 20 byte readv starts. */
+    CHECK(spsc_fifo_write_n(fifo, in, 10));
+    CHECK(spsc_fifo_read_avail(fifo) == 10);
+    CHECK(spsc_fifo_write_n(fifo, in + 10, 10));
+    CHECK(spsc_fifo_readv(fifo, parts + 1, 1) == 20 && memcmp(in, out + 10, 20) == 0);
+
+    CHECK(!spsc_fifo_writev_n(fifo, message, -1));
+    CHECK(spsc_fifo_readv(fifo, parts, -1) == 0);
+
+    spsc_fifo_free(&fifo);
+}
+
+#ifdef SPSC_FIFO_EVENTFD
+static bool fd_ready(int fd) {
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    return poll(&pfd, 1, 0) == 1;
+}
+
+/* Event fds: an armed fd fires once the whole armed amount is there, not before, and on close. Arming for what is
+   already there, nothing or more than capacity is refused. */
+static void test_eventfd(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 64) == spsc_fifo_alloc_success);
+    CHECK(spsc_fifo_read_fd(fifo) == -1 && !spsc_fifo_arm_read_fd(fifo, 1));
+    CHECK(spsc_fifo_enable_fds(fifo));
+
+    const int read_fd  = spsc_fifo_read_fd(fifo);
+    const int write_fd = spsc_fifo_write_fd(fifo);
+    CHECK(read_fd >= 0 && write_fd >= 0);
+
+    spsc_fifo_byte in[64], out[64];
+    fill(in, sizeof(in), 23);
+
+    CHECK(!spsc_fifo_arm_read_fd(fifo, 0) && !spsc_fifo_arm_read_fd(fifo, 65));
+    CHECK(!spsc_fifo_arm_write_fd(fifo, 0) && !spsc_fifo_arm_write_fd(fifo, 65));
+
+    CHECK(spsc_fifo_write_n(fifo, in, 4));
+    CHECK(!spsc_fifo_arm_read_fd(fifo, 4));
+    CHECK(spsc_fifo_arm_read_fd(fifo, 10) && !fd_ready(read_fd));
+    CHECK(spsc_fifo_write_n(fifo, in + 4, 4) && !fd_ready(read_fd));
+    CHECK(spsc_fifo_write_n(fifo, in + 8, 2) && fd_ready(read_fd));
+    CHECK(spsc_fifo_read_n(fifo, out, 10) && memcmp(in, out, 10) == 0);
+
+    CHECK(spsc_fifo_write_n(fifo, in, 60));
+    CHECK(!spsc_fifo_arm_write_fd(fifo, 4));
+    CHECK(spsc_fifo_arm_write_fd(fifo, 10) && !fd_ready(write_fd));
+    CHECK(spsc_fifo_skip_n(fifo, 4) && !fd_ready(write_fd));
+    CHECK(spsc_fifo_skip_n(fifo, 2) && fd_ready(write_fd));
+    CHECK(spsc_fifo_skip_n(fifo, 54) && spsc_fifo_is_empty(fifo));
+
+    CHECK(spsc_fifo_arm_read_fd(fifo, 1) && !fd_ready(read_fd));
+    spsc_fifo_close_write(fifo);
+    CHECK(fd_ready(read_fd) && !spsc_fifo_arm_read_fd(fifo, 1));
+
+    spsc_fifo_free(&fifo);
+}
+#endif
+
+#ifdef SPSC_FIFO_WAIT
+#define WAIT_CHUNK 61
+#define WAIT_CHUNKS 20000
+
+static struct timespec deadline_in(long ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += ms * 1000000L;
+    deadline.tv_sec  += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    return deadline;
+}
+
+static int wait_produce(void *arg) {
+    spsc_fifo *fifo = arg;
+    spsc_fifo_byte in[WAIT_CHUNK];
+    for (unsigned i = 0; i < WAIT_CHUNKS; ++i) {
+        fill(in, sizeof(in), i);
+        if (!spsc_fifo_write_n_wait(fifo, in, sizeof(in), NULL)) {
+            return 1;
+        }
+    }
+    spsc_fifo_close_write(fifo);
+    return 0;
+}
+
+/* Blocking functions: deadlines expire, a chunked stream through a small FIFO parks both sides in turn, and
+   closing ends a wait that could never be satisfied. */
+static void test_wait(void) {
+    spsc_fifo *fifo;
+    CHECK(spsc_fifo_alloc(&fifo, 256) == spsc_fifo_alloc_success);
+
+    struct timespec deadline = deadline_in(10);
+    CHECK(!spsc_fifo_wait_readable(fifo, 1, &deadline));
+    CHECK(!spsc_fifo_wait_readable(fifo, 257, NULL));
+
+    thrd_t producer;
+    CHECK(thrd_create(&producer, wait_produce, fifo) == thrd_success);
+
+    spsc_fifo_byte expected[WAIT_CHUNK], out[WAIT_CHUNK];
+    for (unsigned i = 0; i < WAIT_CHUNKS; ++i) {
+        fill(expected, sizeof(expected), i);
+        if (!spsc_fifo_read_n_wait(fifo, out, sizeof(out), NULL) || memcmp(expected, out, sizeof(out)) != 0) {
+            CHECK(!"stream out of order");
+            break;
+        }
+    }
+    CHECK(!spsc_fifo_read_n_wait(fifo, out, 1, NULL) && spsc_fifo_is_eof(fifo));
+
+    int result = 1;
+    CHECK(thrd_join(producer, &result) == thrd_success && result == 0);
+    spsc_fifo_free(&fifo);
+
+    CHECK(spsc_fifo_alloc(&fifo, 16) == spsc_fifo_alloc_success);
+    CHECK(spsc_fifo_write_n(fifo, out, 16));
+    deadline = deadline_in(10);
+    CHECK(!spsc_fifo_wait_writable(fifo, 1, &deadline));
+    spsc_fifo_close_read(fifo);
+    CHECK(!spsc_fifo_wait_writable(fifo, 1, NULL));
+    spsc_fifo_free(&fifo);
+}
+#endif
+
+#ifndef SPSC_FIFO_NO_SHM
+/* File-backed FIFO: unread data survives reopening, batched positions don't, and bad headers or counters are
+   rejected. */
+static void test_file_reopen(void) {
+    unlink(FILE_PATH);
+
+    spsc_fifo *fifo = NULL;
+    spsc_fifo_byte in[100], out[100];
+    fill(in, sizeof(in), 9);
+
+    CHECK(spsc_fifo_file_open(&fifo, FILE_PATH, 4096, 256) == spsc_fifo_alloc_success);
+    if (fifo == NULL) {
+        return;
+    }
+    CHECK(spsc_fifo_write_n(fifo, in, 100) && spsc_fifo_read_n(fifo, out, 30));
+    CHECK(!spsc_fifo_file_sync_due(fifo));
+    CHECK(spsc_fifo_write_n(fifo, in, 100) && spsc_fifo_write_n(fifo, in, 100));
+    CHECK(spsc_fifo_file_sync_due(fifo));
+    CHECK(spsc_fifo_file_sync(fifo) && !spsc_fifo_file_sync_due(fifo));
+    spsc_fifo_set_write_batch(fifo, 1024);
+    CHECK(spsc_fifo_write_n(fifo, in, 50)); /* stays pending: the process "crashes" below */
+    CHECK(munmap(spsc_fifo_mem(fifo), fifo->map_len) == 0);
+
+    CHECK(spsc_fifo_file_open(&fifo, FILE_PATH, 8192, 0) == spsc_fifo_alloc_mismatch);
+    CHECK(spsc_fifo_file_open(&fifo, FILE_PATH, 4096, 0) == spsc_fifo_alloc_success);
+    if (fifo == NULL) {
+        return;
+    }
+    CHECK(spsc_fifo_read_avail(fifo) == 270);
+    CHECK(spsc_fifo_read_n(fifo, out, 70) && memcmp(in + 30, out, 70) == 0);
+    CHECK(spsc_fifo_write_n(fifo, in, 10) && spsc_fifo_read_avail(fifo) == 210);
+
+    /* counters further apart than capacity */
+    fifo->write_shadow = fifo->read_shadow + fifo->capacity + 1;
+    SPSC_FIFO_ATOMIC_STORE(&(fifo->write_count), fifo->write_shadow, SPSC_FIFO_MEMORY_ORDER_RELAXED);
+    spsc_fifo_free(&fifo);
+    CHECK(spsc_fifo_file_open(&fifo, FILE_PATH, 4096, 0) == spsc_fifo_alloc_mismatch);
+
+    unlink(FILE_PATH);
+}
+#endif
+
+int main(void) {
+    test_wrap();
+    test_reserve_acquire();
+    test_mirrored();
+    test_stale_cache();
+    test_records();
+    test_record_pad();
+    test_batch();
+    test_typed();
+    test_static_fifo();
+#ifndef SPSC_FIFO_NO_SHM
+    test_shm();
+#endif
+#ifdef SPSC_FIFO_STATS
+    test_stats();
+#endif
+#ifdef SPSC_FIFO_TRACE
+    test_trace();
+#endif
+    test_counter_width();
+    test_alloc_ex();
+    test_copy_sizes();
+    test_fd_io();
+    test_group();
+    test_bcast();
+    test_close();
+    test_pipeline();
+    test_iovec();
+#ifdef SPSC_FIFO_WAIT
+    test_wait();
+#endif
+#ifdef SPSC_FIFO_EVENTFD
+    test_eventfd();
+#endif
+    test_lossy_lap();
+    test_segments();
+#ifndef SPSC_FIFO_NO_SHM
+    test_file_reopen();
+#endif
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}